@@ -0,0 +1,378 @@
+#include <blah.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "world.h"
+
+using namespace Blah;
+using namespace Zen;
+
+// Micro benchmarks of the World on its own, without the game or its
+// content, so the cost of one operation can be compared between builds.
+// Each benchmark prints the best average over a few runs, in nanoseconds
+// per operation.
+//
+//   blah_sandbox_bench [name...]
+//
+// with no names every benchmark is run
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    const int runs = 5;
+
+    // keeps the compiler from throwing away work whose result isn't used
+    volatile int64_t sink = 0;
+
+    struct Position : public Component {
+        int x = 0;
+        int y = 0;
+    };
+
+    struct Velocity : public Component {
+        int x = 1;
+        int y = 1;
+    };
+
+    // filler types, so entities can carry a realistic number of components
+    template<int N> struct Tag : public Component {
+        int value = N;
+    };
+
+    // draws nothing, so rendering it only costs the World's own bookkeeping
+    struct Sprite : public Component {
+        void render(Batch& batch) override {
+            sink = sink + 1;
+        }
+    };
+
+    // a bit of busywork per update, touching only itself
+    struct Particle : public Component {
+        uint32_t seed = 1;
+
+        static void declare(Access& access) {
+            access.write<Particle>();
+        }
+
+        void update() override {
+            for (int i = 0; i < 64; i++) {
+                seed = seed * 1664525u + 1013904223u;
+            }
+        }
+    };
+
+    // the best of several runs of fn(), per operation
+    template<class F> double best_ns(int operations, int tries, F&& fn) {
+        double best = 0;
+        for (int i = 0; i < tries; i++) {
+            auto start = Clock::now();
+            fn();
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+            best = (i == 0 ? ns : std::min(best, ns));
+        }
+        return best;
+    }
+
+    void report(const char* name, int count, double ns) {
+        printf("%-28s %7d  %9.1f ns\n", name, count, ns);
+    }
+
+    void spawn(World& world, int count) {
+        for (int i = 0; i < count; i++) {
+            auto entity = world.add_entity(Point(i, i));
+            entity->add(Position());
+            entity->add(Velocity());
+        }
+    }
+
+    void destroy_all(World& world) {
+        while (world.first_entity()) {
+            world.destroy_entity(world.first_entity());
+        }
+    }
+
+    // spawning and destroying entities with two components each, into a
+    // fresh World and then into one whose caches are already warm
+    void bench_alloc() {
+        for (int count : { 1000, 10000, 100000 }) {
+            // the World is made and torn down outside of the timing
+            double cold = 0;
+            for (int i = 0; i < runs; i++) {
+                World world;
+                double ns = best_ns(count, 1, [&]() { spawn(world, count); });
+                cold = (i == 0 ? ns : std::min(cold, ns));
+            }
+            report("alloc cold (per entity)", count, cold);
+
+            World world;
+            spawn(world, count);
+            destroy_all(world);
+            report("alloc warm (per entity)", count, best_ns(count, runs, [&]() {
+                spawn(world, count);
+                destroy_all(world);
+            }));
+        }
+    }
+
+    // walking every instance of one type, after a churn of spawns and
+    // destroys has shuffled which instances are in use
+    void bench_iterate() {
+        for (int count : { 1000, 10000, 100000 }) {
+            World world;
+            spawn(world, count);
+
+            int index = 0;
+            for (auto it = world.first_entity(); it;) {
+                auto next = it->next();
+                if (index++ % 3 == 0) {
+                    world.destroy_entity(it);
+                }
+                it = next;
+            }
+            spawn(world, count / 3);
+
+            int live = 0;
+            for (auto it = world.first<Position>(); it; it = (Position*) it->next()) {
+                live++;
+            }
+
+            report("iterate (per component)", live, best_ns(live, runs, [&]() {
+                int64_t sum = 0;
+                for (int pass = 0; pass < 100; pass++) {
+                    for (auto it = world.first<Position>(); it; it = (Position*) it->next()) {
+                        sum += it->x;
+                    }
+                }
+                sink = sum;
+            }) / 100);
+        }
+    }
+
+    // looking up a component on entities that have eight of them, for the
+    // type added first, the type added last and a type they don't have
+    void bench_get() {
+        const int count = 10000;
+        const int passes = 100;
+
+        World world;
+        Vector<Entity*> entities;
+        for (int i = 0; i < count; i++) {
+            auto entity = world.add_entity();
+            entity->add(Tag<0>());
+            entity->add(Tag<1>());
+            entity->add(Tag<2>());
+            entity->add(Tag<3>());
+            entity->add(Tag<4>());
+            entity->add(Tag<5>());
+            entity->add(Tag<6>());
+            entity->add(Tag<7>());
+            entities.push_back(entity);
+        }
+
+        // make sure the missing type has an id before timing
+        world.add_entity()->add(Tag<8>());
+
+        auto lookup = [&](auto get) {
+            return best_ns(count * passes, runs, [&]() {
+                int64_t sum = 0;
+                for (int pass = 0; pass < passes; pass++) {
+                    for (auto& it : entities) {
+                        sum += get(it);
+                    }
+                }
+                sink = sum;
+            });
+        };
+
+        report("get first added", count, lookup([](Entity* it) { return it->get<Tag<0>>()->value; }));
+        report("get last added", count, lookup([](Entity* it) { return it->get<Tag<7>>()->value; }));
+        report("get missing", count, lookup([](Entity* it) { return it->get<Tag<8>>() ? 1 : 0; }));
+    }
+
+    // drawing sprites at a spread of depths. a steady frame has nothing new
+    // to sort, a loaded frame is the first one after a room's worth of
+    // sprites were added, and in a moving frame one in a hundred changed depth
+    void bench_render() {
+        for (int count : { 1000, 4000, 16000 }) {
+            Batch batch;
+            World world;
+            Vector<Sprite*> sprites;
+
+            auto load = [&]() {
+                for (int i = 0; i < count; i++) {
+                    auto sprite = world.add_entity()->add(Sprite());
+                    sprite->depth = (i * 7919) % 64;
+                    sprites.push_back(sprite);
+                }
+            };
+
+            double loaded = 0;
+            for (int i = 0; i < runs; i++) {
+                world.clear();
+                sprites.clear();
+                world.render(batch);
+                load();
+                double ns = best_ns(count, 1, [&]() { world.render(batch); });
+                loaded = (i == 0 ? ns : std::min(loaded, ns));
+            }
+            report("render loaded (per sprite)", count, loaded);
+
+            report("render steady (per sprite)", count, best_ns(count, runs, [&]() {
+                world.render(batch);
+            }));
+
+            int frame = 0;
+            report("render moving (per sprite)", count, best_ns(count, runs, [&]() {
+                for (int i = frame++ % 100; i < count; i += 100) {
+                    sprites[i]->depth = (sprites[i]->depth + 1) % 64;
+                }
+                world.render(batch);
+            }));
+        }
+    }
+
+    // updating a type that declares its access, so the World can split it
+    // across threads once there are enough instances, on 1 to 8 threads
+    void bench_threads() {
+        for (int count : { 256, 4096, 32768 }) {
+            World world;
+            for (int i = 0; i < count; i++) {
+                world.add_entity()->add(Particle());
+            }
+
+            for (int threads : { 1, 2, 4, 8 }) {
+                world.set_threads(threads);
+                world.update();
+
+                char name[32];
+                snprintf(name, sizeof(name), "update on %d (per component)", threads);
+                report(name, count, best_ns(count * 10, runs, [&]() {
+                    for (int i = 0; i < 10; i++) {
+                        world.update();
+                    }
+                }));
+            }
+        }
+    }
+
+    // visiting entities that have a set of types, through each<T...>() and
+    // by walking the first type's instances and checking for the rest. one
+    // in two entities has both types, and one in ten has the rare one
+    void bench_each() {
+        for (int count : { 1000, 10000, 100000 }) {
+            World world;
+            for (int i = 0; i < count; i++) {
+                auto entity = world.add_entity();
+                entity->add(Position());
+                if (i % 2 == 0) {
+                    entity->add(Velocity());
+                }
+                if (i % 10 == 0) {
+                    entity->add(Tag<0>());
+                }
+            }
+
+            report("each common (per match)", count / 2, best_ns(count / 2, runs, [&]() {
+                int64_t sum = 0;
+                world.each<Position, Velocity>([&](Position* position, Velocity* velocity) {
+                    sum += position->x + velocity->x;
+                });
+                sink = sum;
+            }));
+
+            report("walk common (per match)", count / 2, best_ns(count / 2, runs, [&]() {
+                int64_t sum = 0;
+                for (auto it = world.first<Position>(); it; it = (Position*) it->next()) {
+                    if (auto velocity = it->get<Velocity>()) {
+                        sum += it->x + velocity->x;
+                    }
+                }
+                sink = sum;
+            }));
+
+            report("each rare (per match)", count / 10, best_ns(count / 10, runs, [&]() {
+                int64_t sum = 0;
+                world.each<Position, Tag<0>>([&](Position* position, Tag<0>* tag) {
+                    sum += position->x + tag->value;
+                });
+                sink = sum;
+            }));
+
+            report("walk rare (per match)", count / 10, best_ns(count / 10, runs, [&]() {
+                int64_t sum = 0;
+                for (auto it = world.first<Position>(); it; it = (Position*) it->next()) {
+                    if (auto tag = it->get<Tag<0>>()) {
+                        sum += it->x + tag->value;
+                    }
+                }
+                sink = sum;
+            }));
+        }
+    }
+
+    // bringing a room's worth of entities back, by clearing the World and
+    // spawning them again or by restoring a snapshot taken after the first
+    // spawn, the two paths Game::reload_room takes
+    void bench_reload() {
+        for (int count : { 100, 1000, 10000 }) {
+            World world;
+            auto load = [&]() {
+                for (int i = 0; i < count; i++) {
+                    auto entity = world.add_entity(Point(i, i));
+                    entity->add(Position());
+                    entity->add(Velocity());
+                    entity->add(Sprite())->depth = i % 8;
+                }
+            };
+
+            load();
+            world.snapshot();
+
+            report("reload rebuild (per entity)", count, best_ns(count, runs, [&]() {
+                world.clear();
+                load();
+            }));
+
+            report("reload restore (per entity)", count, best_ns(count, runs, [&]() {
+                world.restore();
+            }));
+        }
+    }
+
+    struct Bench {
+        const char* name;
+        void (*run)();
+    };
+
+    const Bench benches[] = {
+        { "alloc", bench_alloc },
+        { "iterate", bench_iterate },
+        { "get", bench_get },
+        { "render", bench_render },
+        { "threads", bench_threads },
+        { "each", bench_each },
+        { "reload", bench_reload },
+    };
+
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    for (auto& it : benches) {
+        bool run = (argc <= 1);
+        for (int i = 1; i < argc; i++) {
+            run = run || strcmp(argv[i], it.name) == 0;
+        }
+
+        if (run) {
+            printf("-- %s\n", it.name);
+            it.run();
+        }
+    }
+    return 0;
+}
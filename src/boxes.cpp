@@ -0,0 +1,259 @@
+#include "boxes.h"
+
+#include <climits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ZEN_BOXES_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define ZEN_BOXES_TARGET(name)
+#else
+#define ZEN_BOXES_TARGET(name) __attribute__((target(name)))
+#endif
+#else
+#define ZEN_BOXES_X86 0
+#endif
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    // the query rect's edges, compared the same way Broadphase::touches does
+    struct Query {
+        int left, top, right, bottom;
+    };
+
+    Query edges(const RectI& rect) {
+        return Query{ rect.x, rect.y, rect.x + rect.w, rect.y + rect.h };
+    }
+
+    bool hit(const Query& q, int left, int top, int right, int bottom) {
+        return left <= q.right && q.left <= right && top <= q.bottom && q.top <= bottom;
+    }
+
+    // appends each set bit's lane without branching on it, since which
+    // lanes hit is close to random
+    int append(unsigned bits, int lanes, int first, int* out, int n) {
+        for (int k = 0; k < lanes; k++) {
+            out[n] = first + k;
+            n += (bits >> k) & 1;
+        }
+        return n;
+    }
+
+    int scalar_range(const int* l, const int* t, const int* r, const int* b, int from, int count, const Query& q, int* out) {
+        int n = 0;
+        for (int i = from; i < from + count; i++) {
+            out[n] = i;
+            n += hit(q, l[i], t[i], r[i], b[i]);
+        }
+        return n;
+    }
+
+#if ZEN_BOXES_X86
+
+    // a box misses when it starts past the query's far edge or ends before
+    // its near one, so the compares are all "greater than". the query's
+    // edges are broadcast once, outside the loops, as right, left, bottom, top
+    ZEN_BOXES_TARGET("sse2")
+    unsigned sse2_hits(const __m128i* q, __m128i l, __m128i t, __m128i r, __m128i b) {
+        __m128i miss = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(l, q[0]), _mm_cmpgt_epi32(q[1], r)),
+            _mm_or_si128(_mm_cmpgt_epi32(t, q[2]), _mm_cmpgt_epi32(q[3], b)));
+        return ~(unsigned) _mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xf;
+    }
+
+    ZEN_BOXES_TARGET("sse2")
+    int sse2_range(const int* l, const int* t, const int* r, const int* b, int from, int count, const Query& query, int* out) {
+        const __m128i q[4] = {
+            _mm_set1_epi32(query.right), _mm_set1_epi32(query.left),
+            _mm_set1_epi32(query.bottom), _mm_set1_epi32(query.top)
+        };
+
+        int n = 0;
+        int i = from;
+        int end = from + count;
+        for (; i + 4 <= end; i += 4) {
+            unsigned bits = sse2_hits(q,
+                _mm_loadu_si128((const __m128i*) (l + i)),
+                _mm_loadu_si128((const __m128i*) (t + i)),
+                _mm_loadu_si128((const __m128i*) (r + i)),
+                _mm_loadu_si128((const __m128i*) (b + i)));
+            n = append(bits, 4, i, out, n);
+        }
+        return n + scalar_range(l, t, r, b, i, end - i, query, out + n);
+    }
+
+    ZEN_BOXES_TARGET("avx2")
+    unsigned avx2_hits(const __m256i* q, __m256i l, __m256i t, __m256i r, __m256i b) {
+        __m256i miss = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(l, q[0]), _mm256_cmpgt_epi32(q[1], r)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(t, q[2]), _mm256_cmpgt_epi32(q[3], b)));
+        return ~(unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xff;
+    }
+
+    ZEN_BOXES_TARGET("avx2")
+    int avx2_range(const int* l, const int* t, const int* r, const int* b, int from, int count, const Query& query, int* out) {
+        int n = 0;
+        int i = from;
+        int end = from + count;
+        if (count >= 8) {
+            const __m256i q[4] = {
+                _mm256_set1_epi32(query.right), _mm256_set1_epi32(query.left),
+                _mm256_set1_epi32(query.bottom), _mm256_set1_epi32(query.top)
+            };
+
+            for (; i + 8 <= end; i += 8) {
+                unsigned bits = avx2_hits(q,
+                    _mm256_loadu_si256((const __m256i*) (l + i)),
+                    _mm256_loadu_si256((const __m256i*) (t + i)),
+                    _mm256_loadu_si256((const __m256i*) (r + i)),
+                    _mm256_loadu_si256((const __m256i*) (b + i)));
+                n = append(bits, 8, i, out, n);
+            }
+
+            // the SSE2 code after this would otherwise stall on the upper halves
+            _mm256_zeroupper();
+        }
+        return n + sse2_range(l, t, r, b, i, end - i, query, out + n);
+    }
+
+    bool cpu_has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 needs the OS to save the wider registers too, not just the CPU
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return os_saves_ymm && (info[1] & (1 << 5));
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool cpu_has_sse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+
+#endif
+
+    Boxes::Kernel best() {
+#if ZEN_BOXES_X86
+        if (cpu_has_avx2()) {
+            return Boxes::Kernel::avx2;
+        }
+        if (cpu_has_sse2()) {
+            return Boxes::Kernel::sse2;
+        }
+#endif
+        return Boxes::Kernel::scalar;
+    }
+
+    Boxes::Kernel& current() {
+        static Boxes::Kernel kernel = best();
+        return kernel;
+    }
+
+}
+
+Boxes::Kernel Boxes::kernel() {
+    return current();
+}
+
+bool Boxes::supported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::scalar: return true;
+        case Kernel::sse2: return best() != Kernel::scalar;
+        case Kernel::avx2: return best() == Kernel::avx2;
+    }
+    return false;
+}
+
+bool Boxes::use(Kernel kernel) {
+    if (!supported(kernel)) {
+        return false;
+    }
+    current() = kernel;
+    return true;
+}
+
+const char* Boxes::name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::scalar: return "scalar";
+        case Kernel::sse2: return "sse2";
+        case Kernel::avx2: return "avx2";
+    }
+    return "unknown";
+}
+
+void Boxes::set(int index, const RectI& rect) {
+    while (m_left.size() <= index) {
+        m_left.push_back(INT_MAX);
+        m_top.push_back(INT_MAX);
+        m_right.push_back(INT_MIN);
+        m_bottom.push_back(INT_MIN);
+    }
+    m_left[index] = rect.x;
+    m_top[index] = rect.y;
+    m_right[index] = rect.x + rect.w;
+    m_bottom[index] = rect.y + rect.h;
+}
+
+void Boxes::clear(int index) {
+    if (index < m_left.size()) {
+        m_left[index] = INT_MAX;
+        m_top[index] = INT_MAX;
+        m_right[index] = INT_MIN;
+        m_bottom[index] = INT_MIN;
+    }
+}
+
+void Boxes::remove(int index) {
+    int last = m_left.size() - 1;
+    m_left[index] = m_left[last];
+    m_top[index] = m_top[last];
+    m_right[index] = m_right[last];
+    m_bottom[index] = m_bottom[last];
+    m_left.erase(last);
+    m_top.erase(last);
+    m_right.erase(last);
+    m_bottom.erase(last);
+}
+
+int Boxes::size() const {
+    return m_left.size();
+}
+
+int Boxes::overlapping(const RectI& rect, int from, int count, int* out) const {
+    auto q = edges(rect);
+    auto l = m_left.data(), t = m_top.data(), r = m_right.data(), b = m_bottom.data();
+
+    // most buckets hold one or two boxes, too few to fill even an SSE2 register
+    if (count < 4) {
+        return scalar_range(l, t, r, b, from, count, q, out);
+    }
+
+    switch (current()) {
+#if ZEN_BOXES_X86
+        case Kernel::avx2: return avx2_range(l, t, r, b, from, count, q, out);
+        case Kernel::sse2: return sse2_range(l, t, r, b, from, count, q, out);
+#endif
+        default: return scalar_range(l, t, r, b, from, count, q, out);
+    }
+}
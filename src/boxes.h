@@ -0,0 +1,49 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+
+using namespace Blah;
+
+namespace Zen {
+
+    // Rect bounds stored as separate arrays of edges, so one rect can be
+    // tested against several of them at once. Edges are inclusive, the way
+    // the broadphase compares bounds, so rects that only touch still count.
+    class Boxes {
+    public:
+        // which code tests the boxes. the best one the CPU supports is picked
+        // on first use, and any it supports can be chosen instead
+        enum class Kernel {
+            scalar,
+            sse2,
+            avx2
+        };
+
+        static Kernel kernel();
+        static bool supported(Kernel kernel);
+        static bool use(Kernel kernel);
+        static const char* name(Kernel kernel);
+
+        // sets a box, growing the arrays to fit it
+        void set(int index, const RectI& rect);
+
+        // sets a box that overlaps nothing
+        void clear(int index);
+
+        // removes a box by moving the last one into its place
+        void remove(int index);
+
+        int size() const;
+
+        // writes the index of each box in [from, from + count) that overlaps
+        // the rect to out, in order, and returns how many there were
+        int overlapping(const RectI& rect, int from, int count, int* out) const;
+
+    private:
+        Vector<int> m_left;
+        Vector<int> m_top;
+        Vector<int> m_right;
+        Vector<int> m_bottom;
+    };
+
+}
@@ -0,0 +1,310 @@
+#include "broadphase.h"
+#include "components/collider.h"
+
+#include <algorithm>
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    // rounds towards negative infinity, unlike integer division
+    int floor_div(int value, int divisor) {
+        return (value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor));
+    }
+
+    bool same(const RectI& a, const RectI& b) {
+        return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+    }
+
+}
+
+Broadphase::Broadphase() = default;
+
+Broadphase::Layer::~Layer() {
+    for (auto it : buckets) {
+        delete it;
+    }
+}
+
+Broadphase::~Broadphase() {
+    for (auto it : m_layers) {
+        delete it;
+    }
+}
+
+void Broadphase::insert(Collider* collider) {
+    if (collider->m_proxy.index >= 0) {
+        return;
+    }
+
+    int index;
+    if (m_free_proxy >= 0) {
+        index = m_free_proxy;
+        m_free_proxy = m_proxies[index].first_node;
+    } else {
+        index = m_proxies.size();
+        m_proxies.expand();
+    }
+
+    auto& proxy = m_proxies[index];
+    proxy.collider = collider;
+    proxy.mask = 0;
+    proxy.first_node = -1;
+    proxy.large = false;
+    proxy.is_static = false;
+    proxy.stamp = m_stamp;
+    collider->m_proxy.index = index;
+
+    place(index);
+    m_count++;
+    touched(proxy.mask);
+}
+
+void Broadphase::remove(Collider* collider) {
+    int index = collider->m_proxy.index;
+    if (index < 0) {
+        return;
+    }
+
+    touched(m_proxies[index].mask);
+    unplace(index);
+    m_boxes.clear(index);
+    m_proxies[index].collider = nullptr;
+    m_proxies[index].first_node = m_free_proxy;
+    m_free_proxy = index;
+    collider->m_proxy.index = -1;
+    m_count--;
+}
+
+void Broadphase::refresh(Collider* collider) {
+    int index = collider->m_proxy.index;
+    if (index < 0) {
+        return;
+    }
+
+    auto& proxy = m_proxies[index];
+    auto bounds = collider->bounds();
+    proxy.position = collider->entity()->position;
+
+    if (same(bounds, proxy.bounds) && proxy.mask == collider->m_mask && proxy.is_static == collider->m_static) {
+        return;
+    }
+    touched(proxy.mask | collider->m_mask);
+
+    // most moves stay within the same cells, and only the bounds change
+    int left, top, right, bottom;
+    cells(bounds, left, top, right, bottom);
+    if (!proxy.large && !proxy.is_static && !collider->m_static && proxy.mask == collider->m_mask
+     && left == proxy.left && top == proxy.top && right == proxy.right && bottom == proxy.bottom) {
+        proxy.bounds = bounds;
+        m_boxes.set(index, bounds);
+        for (int node = proxy.first_node; node >= 0; node = m_nodes[node].next_in_proxy) {
+            auto& it = m_nodes[node];
+            m_layers[it.layer]->buckets[it.bucket]->boxes.set(it.slot, bounds);
+        }
+        return;
+    }
+
+    unplace(index);
+    place(index);
+}
+
+void Broadphase::refresh(Entity* entity) {
+    auto type = Component::type_id<Collider>();
+    for (auto& it : entity->components()) {
+        if (it->type() == type) {
+            refresh((Collider*) it);
+        }
+    }
+}
+
+void Broadphase::before_update() {
+    for (int i = 0; i < m_proxies.size(); i++) {
+        auto& proxy = m_proxies[i];
+        if (proxy.collider && proxy.collider->entity()->position != proxy.position) {
+            refresh(proxy.collider);
+        }
+    }
+}
+
+int Broadphase::count() const {
+    return m_count;
+}
+
+void Broadphase::changed(Collider* collider) {
+    int index = collider->m_proxy.index;
+    if (index >= 0) {
+        touched(m_proxies[index].mask);
+    }
+}
+
+uint32_t Broadphase::version() const {
+    return m_version;
+}
+
+uint32_t Broadphase::version(uint32_t mask) const {
+    // layer versions only ever go up, so neither can their sum
+    uint32_t version = 0;
+    for (int bit = 0; bit < max_layers; bit++) {
+        if ((mask & (1u << bit)) && m_layers[bit]) {
+            version += m_layers[bit]->version;
+        }
+    }
+    return version;
+}
+
+void Broadphase::touched(uint32_t mask) {
+    m_version++;
+    for (int bit = 0; bit < max_layers; bit++) {
+        if ((mask & (1u << bit)) && m_layers[bit]) {
+            m_layers[bit]->version++;
+        }
+    }
+}
+
+void Broadphase::cells(const RectI& rect, int& left, int& top, int& right, int& bottom) {
+    left = floor_div(rect.x, cell_size);
+    top = floor_div(rect.y, cell_size);
+    right = floor_div(rect.x + (rect.w > 0 ? rect.w : 0), cell_size);
+    bottom = floor_div(rect.y + (rect.h > 0 ? rect.h : 0), cell_size);
+}
+
+void Broadphase::place(int index) {
+    auto& proxy = m_proxies[index];
+    proxy.bounds = proxy.collider->bounds();
+    proxy.position = proxy.collider->entity()->position;
+    proxy.mask = proxy.collider->m_mask;
+    proxy.is_static = proxy.collider->m_static;
+    m_boxes.set(index, proxy.bounds);
+    cells(proxy.bounds, proxy.left, proxy.top, proxy.right, proxy.bottom);
+
+    // big colliders (like a room's solid grid) go on the list every query checks
+    proxy.large = (proxy.right - proxy.left + 1) * (proxy.bottom - proxy.top + 1) > max_cells;
+
+    for (int bit = 0; bit < max_layers; bit++) {
+        if (!(proxy.mask & (1u << bit))) {
+            continue;
+        }
+
+        auto& layer = m_layers[bit];
+        if (!layer) {
+            layer = new Layer();
+        }
+        layer->count++;
+
+        if (proxy.is_static) {
+            layer->statics.push_back(index);
+            layer->statics_sorted = false;
+            continue;
+        }
+
+        if (proxy.large) {
+            layer->large.push_back(index);
+            continue;
+        }
+
+        for (int y = proxy.top; y <= proxy.bottom; y++) {
+            for (int x = proxy.left; x <= proxy.right; x++) {
+                int node_index;
+                if (m_free_node >= 0) {
+                    node_index = m_free_node;
+                    m_free_node = m_nodes[node_index].next_in_proxy;
+                } else {
+                    node_index = m_nodes.size();
+                    m_nodes.expand();
+                }
+
+                auto& node = m_nodes[node_index];
+                node.proxy = index;
+                node.layer = bit;
+                node.bucket = bucket(x, y);
+
+                auto& cell = layer->buckets[node.bucket];
+                if (!cell) {
+                    cell = new Bucket();
+                }
+                node.slot = cell->nodes.size();
+                cell->nodes.push_back(node_index);
+                cell->boxes.set(node.slot, proxy.bounds);
+
+                node.next_in_proxy = proxy.first_node;
+                proxy.first_node = node_index;
+            }
+        }
+    }
+}
+
+void Broadphase::unplace(int index) {
+    auto& proxy = m_proxies[index];
+
+    for (int bit = 0; bit < max_layers; bit++) {
+        if (!(proxy.mask & (1u << bit))) {
+            continue;
+        }
+
+        auto layer = m_layers[bit];
+        layer->count--;
+
+        // there are only ever a handful of static and large proxies, so just look for it
+        if (proxy.is_static) {
+            for (int i = 0; i < layer->statics.size(); i++) {
+                if (layer->statics[i] == index) {
+                    layer->statics.erase(i);
+                    break;
+                }
+            }
+            layer->statics_sorted = false;
+        } else if (proxy.large) {
+            for (int i = 0; i < layer->large.size(); i++) {
+                if (layer->large[i] == index) {
+                    layer->large[i] = layer->large[layer->large.size() - 1];
+                    layer->large.erase(layer->large.size() - 1);
+                    break;
+                }
+            }
+        }
+    }
+    proxy.large = false;
+    proxy.is_static = false;
+
+    int node_index = proxy.first_node;
+    while (node_index >= 0) {
+        auto& node = m_nodes[node_index];
+
+        // the bucket's last entry takes this one's place
+        auto cell = m_layers[node.layer]->buckets[node.bucket];
+        int last = cell->nodes.size() - 1;
+        if (node.slot != last) {
+            int moved = cell->nodes[last];
+            cell->nodes[node.slot] = moved;
+            m_nodes[moved].slot = node.slot;
+        }
+        cell->nodes.erase(last);
+        cell->boxes.remove(node.slot);
+
+        int next = node.next_in_proxy;
+        node.next_in_proxy = m_free_node;
+        m_free_node = node_index;
+        node_index = next;
+    }
+    proxy.first_node = -1;
+}
+
+void Broadphase::sort_statics(Layer& layer) {
+    std::sort(layer.statics.begin(), layer.statics.end(), [this](int a, int b) {
+        return m_proxies[a].bounds.x < m_proxies[b].bounds.x;
+    });
+
+    layer.static_reach.clear();
+    for (int i = 0; i < layer.statics.size(); i++) {
+        auto& bounds = m_proxies[layer.statics[i]].bounds;
+        int reach = bounds.x + bounds.w;
+        if (i > 0 && layer.static_reach[i - 1] > reach) {
+            reach = layer.static_reach[i - 1];
+        }
+        layer.static_reach.push_back(reach);
+    }
+
+    layer.statics_sorted = true;
+}
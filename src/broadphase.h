@@ -0,0 +1,271 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+#include <algorithm>
+#include "boxes.h"
+
+using namespace Blah;
+
+namespace Zen {
+
+    class Entity;
+    class Collider;
+
+    // A spatial hash of collider bounds, one per World (see World::service).
+    // Colliders are bucketed by the cells their bounds cover, so a query only
+    // looks at colliders near it rather than at every collider in the world.
+    // Colliders too big to be worth hashing are kept on a list that every
+    // query checks.
+    //
+    // Each mask bit gets its own layer of buckets, and a collider sits in the
+    // layer of every bit in its mask. A query for a mask only has to search
+    // the layer of one of its bits, so checking for solids never walks past
+    // enemies, and a layer with nothing in it is skipped outright.
+    //
+    // Static colliders (see Collider::set_static) stay out of the buckets.
+    // Each layer keeps them sorted by their left edge, sorting again only
+    // after one is added, removed or changed, which in practice means once
+    // per room. A query searches that list and then the buckets.
+    //
+    // A bucket keeps its entries in an array, with their bounds alongside in
+    // a Boxes, so a bucket holding more than a handful of colliders is tested
+    // several at a time and a proxy is only read once its bounds overlap.
+    class Broadphase {
+    public:
+        static constexpr int cell_size = 32;
+        static constexpr int bucket_count = 4096;
+        static constexpr int max_cells = 16;
+        static constexpr int max_layers = 32;
+
+        // how many boxes are tested before their hits are visited
+        static constexpr int batch_size = 64;
+
+        // a collider's place in the broadphase. copying a collider doesn't
+        // copy its place, the copy takes its own when it's added to a World
+        class Handle {
+        public:
+            Handle() = default;
+            Handle(const Handle&) {}
+            Handle& operator=(const Handle&) { return *this; }
+
+        private:
+            friend class Broadphase;
+            int index = -1;
+        };
+
+        Broadphase();
+        Broadphase(const Broadphase&) = delete;
+        Broadphase& operator=(const Broadphase&) = delete;
+        ~Broadphase();
+
+        void insert(Collider* collider);
+        void remove(Collider* collider);
+
+        // re-buckets a collider after its bounds or mask changed
+        void refresh(Collider* collider);
+
+        // lets results that depend on a collider know its shape changed
+        // in a way its bounds don't show, like a grid's cells
+        void changed(Collider* collider);
+
+        // re-buckets every collider on an entity after it moved
+        void refresh(Entity* entity);
+
+        // catches entities that were moved between updates
+        void before_update();
+
+        // calls fn(collider) for colliders whose bounds overlap the rect and
+        // whose mask has every bit in the given mask, though possibly others
+        // as well. stops early and returns true as soon as fn does
+        template<class F> bool any(uint32_t mask, const RectI& rect, F&& fn);
+
+        int count() const;
+
+        // changes whenever a collider is added, removed, moved or resized,
+        // so results worked out from the broadphase can tell they're stale
+        uint32_t version() const;
+
+        // the same, but only for changes to colliders with any of the mask's bits
+        uint32_t version(uint32_t mask) const;
+
+    private:
+        struct Proxy {
+            Collider* collider;
+            RectI bounds;
+            Point position;
+            uint32_t mask;
+            int left, top, right, bottom;
+            int first_node;
+            bool large;
+            bool is_static;
+            uint32_t stamp;
+        };
+
+        // a proxy's entry in one bucket of one layer
+        struct Node {
+            int proxy;
+            int layer;
+            int bucket;
+            int slot;
+            int next_in_proxy;
+        };
+
+        // a conservative overlap test, so empty rects still reach the exact checks
+        static bool touches(const RectI& a, const RectI& b);
+
+        // the nodes in one bucket, and their bounds at the same index
+        struct Bucket {
+            Vector<int> nodes;
+            Boxes boxes;
+        };
+
+        // the buckets of one mask bit, each made the first time it's used
+        struct Layer {
+            Bucket* buckets[bucket_count] = {};
+            Vector<int> large;
+
+            // static proxies by left edge, and the furthest right edge of
+            // any of them up to each index
+            Vector<int> statics;
+            Vector<int> static_reach;
+            bool statics_sorted = true;
+
+            // starts above 0 so a layer being made counts as a change too
+            uint32_t version = 1;
+            int count = 0;
+
+            ~Layer();
+        };
+
+        static int bucket(int x, int y);
+        static int lowest_bit(uint32_t mask);
+        static void cells(const RectI& rect, int& left, int& top, int& right, int& bottom);
+
+        void place(int proxy);
+        void unplace(int proxy);
+        void sort_statics(Layer& layer);
+        void touched(uint32_t mask);
+
+        Vector<Proxy> m_proxies;
+        Vector<Node> m_nodes;
+        int m_free_proxy = -1;
+        int m_free_node = -1;
+        int m_count = 0;
+        uint32_t m_stamp = 0;
+        uint32_t m_version = 0;
+        Layer* m_layers[max_layers] = {};
+
+        // every proxy's bounds by index, for queries that look at all of them
+        Boxes m_boxes;
+    };
+
+    inline bool Broadphase::touches(const RectI& a, const RectI& b) {
+        return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+    }
+
+    inline int Broadphase::bucket(int x, int y) {
+        return (int) (((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u)) & (bucket_count - 1);
+    }
+
+    inline int Broadphase::lowest_bit(uint32_t mask) {
+        int bit = 0;
+        while (!(mask & 1)) {
+            mask >>= 1;
+            bit++;
+        }
+        return bit;
+    }
+
+    template<class F> bool Broadphase::any(uint32_t mask, const RectI& rect, F&& fn) {
+        // every collider matches an empty mask, and those aren't layered
+        if (mask == 0) {
+            int found[batch_size];
+            for (int from = 0; from < m_proxies.size(); from += batch_size) {
+                int count = std::min(batch_size, m_proxies.size() - from);
+                int hits = m_boxes.overlapping(rect, from, count, found);
+                for (int i = 0; i < hits; i++) {
+                    auto& proxy = m_proxies[found[i]];
+                    if (proxy.collider && fn(proxy.collider)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // anything matching the mask has its lowest bit, so that layer has them all
+        auto layer = m_layers[lowest_bit(mask)];
+        if (!layer || layer->count == 0) {
+            return false;
+        }
+
+        // statics whose left edge is far enough left, walking right to left
+        // until none of the rest reach far enough right
+        if (layer->statics.size() > 0) {
+            if (!layer->statics_sorted) {
+                sort_statics(*layer);
+            }
+
+            int low = 0;
+            int high = layer->statics.size();
+            while (low < high) {
+                int mid = (low + high) / 2;
+                if (m_proxies[layer->statics[mid]].bounds.x <= rect.x + rect.w) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+
+            for (int i = low - 1; i >= 0 && layer->static_reach[i] >= rect.x; i--) {
+                auto& proxy = m_proxies[layer->statics[i]];
+                if (touches(proxy.bounds, rect) && fn(proxy.collider)) {
+                    return true;
+                }
+            }
+        }
+
+        // stamps keep a proxy that spans several cells from being visited twice
+        m_stamp++;
+
+        for (int i = 0; i < layer->large.size(); i++) {
+            auto& proxy = m_proxies[layer->large[i]];
+            if (touches(proxy.bounds, rect) && fn(proxy.collider)) {
+                return true;
+            }
+        }
+
+        int left, top, right, bottom;
+        cells(rect, left, top, right, bottom);
+
+        int found[batch_size];
+        for (int y = top; y <= bottom; y++) {
+            for (int x = left; x <= right; x++) {
+                auto cell = layer->buckets[bucket(x, y)];
+                if (!cell) {
+                    continue;
+                }
+
+                for (int from = 0; from < cell->nodes.size(); from += batch_size) {
+                    int count = std::min(batch_size, cell->nodes.size() - from);
+                    int hits = cell->boxes.overlapping(rect, from, count, found);
+
+                    for (int i = 0; i < hits; i++) {
+                        auto& proxy = m_proxies[m_nodes[cell->nodes[found[i]]].proxy];
+                        if (proxy.stamp == m_stamp) {
+                            continue;
+                        }
+                        proxy.stamp = m_stamp;
+
+                        if (fn(proxy.collider)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+}
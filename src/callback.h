@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Zen {
+
+    template<class Signature, size_t Capacity = 16> class Callback;
+
+    // A callable stored inline in a fixed amount of space, so setting and
+    // copying one never allocates. Anything that doesn't fit is a compile
+    // error rather than a silent trip to the heap.
+    //
+    // Callbacks are copyable, since components get copied when they're added
+    // to a World and when it takes a snapshot, so whatever they hold has to
+    // be copyable too. Captures are copied along with them, so mutable state
+    // like [health = 3] belongs to each copy.
+    template<class R, class... Args, size_t Capacity> class Callback<R(Args...), Capacity> {
+    public:
+        static constexpr size_t capacity = Capacity;
+
+        Callback() = default;
+        Callback(std::nullptr_t) {}
+
+        template<class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Callback>>>
+        Callback(F&& fn) {
+            emplace(std::forward<F>(fn));
+        }
+
+        Callback(const Callback& other) {
+            copy_from(other);
+        }
+
+        Callback(Callback&& other) noexcept {
+            move_from(other);
+        }
+
+        ~Callback() {
+            reset();
+        }
+
+        Callback& operator=(const Callback& other) {
+            if (this != &other) {
+                reset();
+                copy_from(other);
+            }
+            return *this;
+        }
+
+        Callback& operator=(Callback&& other) noexcept {
+            if (this != &other) {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        Callback& operator=(std::nullptr_t) {
+            reset();
+            return *this;
+        }
+
+        template<class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Callback>>>
+        Callback& operator=(F&& fn) {
+            reset();
+            emplace(std::forward<F>(fn));
+            return *this;
+        }
+
+        explicit operator bool() const {
+            return m_invoke != nullptr;
+        }
+
+        R operator()(Args... args) {
+            return m_invoke(m_storage, std::forward<Args>(args)...);
+        }
+
+    private:
+        enum class Op { Copy, Move, Destroy };
+
+        template<class F> void emplace(F&& fn) {
+            using T = std::decay_t<F>;
+            static_assert(sizeof(T) <= Capacity, "Callback capture is too big, give it a larger capacity");
+            static_assert(alignof(T) <= alignof(std::max_align_t), "Callback capture is over-aligned");
+            static_assert(std::is_copy_constructible_v<T>, "Callback target must be copyable");
+            static_assert(std::is_nothrow_move_constructible_v<T>, "Callback target must be nothrow movable");
+
+            new (m_storage) T(std::forward<F>(fn));
+            m_invoke = [](void* storage, Args... args) -> R {
+                return (*(T*) storage)(std::forward<Args>(args)...);
+            };
+
+            // trivial targets (plain functions, empty or pod captures) are
+            // copied with the storage and need no managing at all
+            if constexpr (std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>) {
+                m_manage = nullptr;
+            } else {
+                m_manage = [](Op op, void* to, void* from) {
+                    switch (op) {
+                        case Op::Copy: new (to) T(*(const T*) from); break;
+                        case Op::Move: new (to) T(std::move(*(T*) from)); break;
+                        case Op::Destroy: ((T*) to)->~T(); break;
+                    }
+                };
+            }
+        }
+
+        void copy_from(const Callback& other) {
+            if (other.m_manage) {
+                other.m_manage(Op::Copy, m_storage, (void*) other.m_storage);
+            } else {
+                memcpy(m_storage, other.m_storage, Capacity);
+            }
+            m_invoke = other.m_invoke;
+            m_manage = other.m_manage;
+        }
+
+        void move_from(Callback& other) {
+            if (other.m_manage) {
+                other.m_manage(Op::Move, m_storage, other.m_storage);
+            } else {
+                memcpy(m_storage, other.m_storage, Capacity);
+            }
+            m_invoke = other.m_invoke;
+            m_manage = other.m_manage;
+            other.reset();
+        }
+
+        void reset() {
+            if (m_manage) {
+                m_manage(Op::Destroy, m_storage, nullptr);
+            }
+            m_invoke = nullptr;
+            m_manage = nullptr;
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[Capacity] = {};
+        R (*m_invoke)(void* storage, Args... args) = nullptr;
+        void (*m_manage)(Op op, void* to, void* from) = nullptr;
+    };
+
+}
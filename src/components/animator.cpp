@@ -34,6 +34,11 @@ void Animator::play(const String& animation, bool restart) {
     }
 }
 
+void Animator::declare(Access& access) {
+    // frame advance only touches the animator itself
+    access.write<Animator>();
+}
+
 void Animator::update() {
     if (in_valid_state()) {
         // quick references
@@ -59,7 +64,7 @@ void Animator::update() {
 
 void Animator::render(Batch& batch) {
     if (in_valid_state()) {
-        batch.push_matrix(Mat3x2::create_transform(entity()->position, m_sprite->origin, scale, 0));
+        batch.push_matrix(Mat3x2::create_transform(entity()->render_position(), m_sprite->origin, scale, 0));
 
         auto& anim = m_sprite->animations[m_animation_index];
         auto& frame = anim.frames[m_frame_index];
@@ -24,6 +24,8 @@ namespace Zen {
 
         void play(const String& animation, bool restart = false);
 
+        static void declare(Access& access);
+
         void update() override;
         void render(Batch& batch) override;
 
@@ -1,10 +1,41 @@
 #include "collider.h"
 
+#include <algorithm>
+
 using namespace Blah;
 using namespace Zen;
 
+namespace {
+
+    // integer division rounding towards negative and positive infinity
+    int floor_div(int value, int divisor) {
+        return (value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor));
+    }
+
+    int ceil_div(int value, int divisor) {
+        return -floor_div(-value, divisor);
+    }
+
+    // the steps 0..steps in a direction of sign (1 or -1) over which a span
+    // starting at a with length len overlaps the span from b with length blen
+    bool span_run(int a, int len, int b, int blen, int sign, int steps, int& lo, int& hi) {
+        // overlapping at an offset t means b - a - len < t < b + blen - a
+        int first = b - a - len + 1;
+        int last = b + blen - a - 1;
+        if (sign < 0) {
+            int swap = first;
+            first = -last;
+            last = -swap;
+        }
+
+        lo = (first > 0 ? first : 0);
+        hi = (last < steps ? last : steps);
+        return lo <= hi;
+    }
+
+}
+
 Collider::Collider() {
-    visible = false;
     active = false;
 }
 
@@ -21,8 +52,9 @@ Collider Collider::make_grid(int tile_size, int columns, int rows) {
     collider.m_grid.tile_size = tile_size;
     collider.m_grid.columns = columns;
     collider.m_grid.rows = rows;
+    collider.m_grid.row_words = (columns + Grid::word_bits - 1) / Grid::word_bits;
 
-    collider.m_grid.cells.expand(columns * rows);
+    collider.m_grid.words.expand(collider.m_grid.row_words * rows);
     return collider;
 }
 
@@ -30,6 +62,38 @@ Collider::Shape Collider::shape() const {
     return m_shape;
 }
 
+RectI Collider::bounds() const {
+    auto position = entity()->position;
+    if (m_shape == Shape::Grid) {
+        return RectI(position.x, position.y, m_grid.columns * m_grid.tile_size, m_grid.rows * m_grid.tile_size);
+    }
+    return m_rect + position;
+}
+
+uint32_t Collider::get_mask() const {
+    return m_mask;
+}
+
+void Collider::set_mask(uint32_t value) {
+    m_mask = value;
+
+    if (world()) {
+        broadphase().refresh(this);
+    }
+}
+
+bool Collider::is_static() const {
+    return m_static;
+}
+
+void Collider::set_static(bool value) {
+    m_static = value;
+
+    if (world()) {
+        broadphase().refresh(this);
+    }
+}
+
 RectI Collider::get_rect() const {
     BLAH_ASSERT(m_shape == Shape::Rect, "Collider is not a Rectangle!");
     return m_rect;
@@ -38,55 +102,102 @@ RectI Collider::get_rect() const {
 void Collider::set_rect(const RectI& value) {
     BLAH_ASSERT(m_shape == Shape::Rect, "Collider is not a Rectangle!");
     m_rect = value;
+
+    if (world()) {
+        broadphase().refresh(this);
+    }
 }
 
 bool Collider::get_cell(int x, int y) const {
     BLAH_ASSERT(m_shape == Shape::Grid, "Collider is not a Grid!");
     BLAH_ASSERT(x >= 0 && y >= 0 && x < m_grid.columns && y < m_grid.rows, "Cell is out of bounds!");
 
-    return m_grid.cells[x + y * m_grid.columns];
+    auto word = m_grid.words[x / Grid::word_bits + y * m_grid.row_words];
+    return (word >> (x % Grid::word_bits)) & 1;
 }
 
 void Collider::set_cell(int x, int y, bool value) {
     BLAH_ASSERT(m_shape == Shape::Grid, "Collider is not a Grid!");
     BLAH_ASSERT(x >= 0 && y >= 0 && x < m_grid.columns && y < m_grid.rows, "Cell is out of bounds!");
 
-    m_grid.cells[x + y * m_grid.columns] = value;
+    auto& word = m_grid.words[x / Grid::word_bits + y * m_grid.row_words];
+    auto bit = (uint64_t) 1 << (x % Grid::word_bits);
+    auto was = word;
+    if (value) {
+        word |= bit;
+    } else {
+        word &= ~bit;
+    }
+
+    // only results on this layer care, and only if a cell actually flipped
+    if (word != was && world()) {
+        broadphase().changed(this);
+    }
 }
 
 void Collider::set_cells(int x, int y, int w, int h, bool value) {
-    for (int ix = x; ix < x + w; ix++) {
-        for (int iy = y; iy < y + h; iy++) {
-            set_cell(ix, iy, value);
+    BLAH_ASSERT(m_shape == Shape::Grid, "Collider is not a Grid!");
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    BLAH_ASSERT(x >= 0 && y >= 0 && x + w <= m_grid.columns && y + h <= m_grid.rows, "Cells are out of bounds!");
+
+    // fill each row a word at a time, masking the partial words at the ends
+    int first = x / Grid::word_bits;
+    int last = (x + w - 1) / Grid::word_bits;
+    uint64_t flipped = 0;
+    for (int iy = y; iy < y + h; iy++) {
+        auto row = m_grid.words.data() + iy * m_grid.row_words;
+        for (int i = first; i <= last; i++) {
+            int from = (i == first ? x % Grid::word_bits : 0);
+            int to = (i == last ? (x + w - 1) % Grid::word_bits + 1 : Grid::word_bits);
+            auto bits = word_range(from, to);
+            auto was = row[i];
+            if (value) {
+                row[i] |= bits;
+            } else {
+                row[i] &= ~bits;
+            }
+            flipped |= was ^ row[i];
         }
     }
+
+    if (flipped && world()) {
+        broadphase().changed(this);
+    }
 }
 
 bool Collider::check(uint32_t mask, Point offset) const {
-    auto other = world()->first<Collider>();
-    while (other) {
+    // only colliders on the mask's layer and near the offset bounds can overlap them
+    return broadphase().any(mask, bounds() + offset, [&](const Collider* other) {
+        return other != this
+            && (other->m_mask & mask) == mask
+            && overlaps(other, offset);
+    });
+}
+
+int Collider::query(uint32_t mask, const RectI& rect, Collider** out, int capacity) const {
+    int count = 0;
+    broadphase().any(mask, rect, [&](const Collider* other) {
         if (other != this
-         && (other->mask & mask) == mask
-         && overlaps(other, offset)) {
-            return true;
+         && (other->m_mask & mask) == mask
+         && rect_overlaps(rect, other)) {
+            if (count < capacity) {
+                out[count] = (Collider*) other;
+            }
+            count++;
         }
-
-        other = (Collider*) other->next();
-    }
-
-    return false;
+        return false;
+    });
+    return count;
 }
 
 bool Collider::overlaps(const Collider *other, Point offset) const {
     if (m_shape == Shape::Rect) {
-        if (other->m_shape == Shape::Rect) {
-            return rect_to_rect(this, other, offset);
-        } else if (other->m_shape == Shape::Grid) {
-            return rect_to_grid(this, other, offset);
-        }
+        return rect_overlaps(m_rect + entity()->position + offset, other);
     } else if (m_shape == Shape::Grid) {
         if (other->m_shape == Shape::Rect) {
-            return rect_to_grid(other, this, offset);
+            return rect_to_grid(other->m_rect + other->entity()->position + offset, this);
         } else if (other->m_shape == Shape::Grid) {
             BLAH_ASSERT(false, "Grid->Grid overap checks not supported!");
         }
@@ -95,17 +206,198 @@ bool Collider::overlaps(const Collider *other, Point offset) const {
     return false;
 }
 
-void Collider::render(Batch& batch) {
+int Collider::sweep(uint32_t mask, Point direction, int steps) const {
+    BLAH_ASSERT(m_shape == Shape::Rect, "Collider is not a Rectangle!");
+    if (steps <= 0) {
+        return 0;
+    }
+
+    // a single step is a plain check, which can stop at the first hit
+    if (steps == 1) {
+        return (check(mask, direction) ? 0 : 1);
+    }
+
+    // the first step that overlaps anything
+    int first = steps + 1;
+    sweep_runs(mask, direction, steps, [&](int lo, int hi) {
+        if (hi >= 1) {
+            first = std::min(first, std::max(lo, 1));
+        }
+    });
+
+    each_sibling(mask, [&](const Collider* other) {
+        if (overlaps(other, direction)) {
+            first = 1;
+        }
+    });
+
+    return first - 1;
+}
+
+int Collider::sweep_onto(uint32_t mask, Point direction, int steps) const {
+    BLAH_ASSERT(m_shape == Shape::Rect, "Collider is not a Rectangle!");
+    if (steps <= 0) {
+        return 0;
+    }
+
+    if (steps == 1) {
+        return (check(mask, direction) && !check(mask, Point::zero) ? 0 : 1);
+    }
+
+    // siblings sit at the same offset every step. if one overlaps already,
+    // every step starts on top of something, so nothing can be landed on
+    bool sibling_now = false;
+    bool sibling_next = false;
+    each_sibling(mask, [&](const Collider* other) {
+        sibling_now = sibling_now || overlaps(other, Point::zero);
+        sibling_next = sibling_next || overlaps(other, direction);
+    });
+    if (sibling_now) {
+        return steps;
+    }
+
+    // steps up to run_end continue an overlap that was already under way at
+    // step 0, so they can't land on anything. the first overlap after that
+    // does. it usually takes a single pass, and one more per run of
+    // overlapping colliders being passed through
+    int run_end = -1;
+    int first;
+    while (true) {
+        int next_end = run_end;
+        first = steps + 1;
+
+        sweep_runs(mask, direction, steps, [&](int lo, int hi) {
+            if (lo <= run_end + 1 && hi > next_end) {
+                next_end = hi;
+            }
+            if (hi > run_end) {
+                first = std::min(first, std::max(std::max(lo, run_end + 1), 1));
+            }
+        });
+
+        if (next_end == run_end) {
+            break;
+        }
+        run_end = next_end;
+    }
+
+    // a sibling overlaps every next step, so it's landed on as soon as
+    // nothing else is overlapped the step before
+    if (sibling_next) {
+        first = std::min(first, run_end + 2);
+    }
+
+    return std::min(first, steps + 1) - 1;
+}
+
+template<class F> void Collider::sweep_runs(uint32_t mask, Point direction, int steps, F&& fn) const {
+    auto rect = m_rect + entity()->position;
+    bool horizontal = (direction.x != 0);
+    int sign = (horizontal ? direction.x : direction.y);
+
+    // the area covered by every step of the move
+    auto swept = rect;
+    if (horizontal) {
+        swept.w += steps;
+        swept.x -= (sign < 0 ? steps : 0);
+    } else {
+        swept.h += steps;
+        swept.y -= (sign < 0 ? steps : 0);
+    }
+
+    broadphase().any(mask, swept, [&](const Collider* other) {
+        if (other == this || other->entity() == entity() || (other->m_mask & mask) != mask) {
+            return false;
+        }
+
+        int lo, hi;
+        if (other->m_shape == Shape::Rect) {
+            auto other_rect = other->m_rect + other->entity()->position;
+            if (horizontal) {
+                if (rect.y < other_rect.y + other_rect.h && other_rect.y < rect.y + rect.h
+                 && span_run(rect.x, rect.w, other_rect.x, other_rect.w, sign, steps, lo, hi)) {
+                    fn(lo, hi);
+                }
+            } else {
+                if (rect.x < other_rect.x + other_rect.w && other_rect.x < rect.x + rect.w
+                 && span_run(rect.y, rect.h, other_rect.y, other_rect.h, sign, steps, lo, hi)) {
+                    fn(lo, hi);
+                }
+            }
+        } else if (other->m_shape == Shape::Grid) {
+            // each row (or column) of cells crossed is a span of its own
+            auto& grid = other->m_grid;
+            auto relative = rect - other->entity()->position;
+            int size = grid.tile_size;
+
+            if (horizontal) {
+                int top    = Calc::clamp_int(floor_div(relative.y,          size), 0, grid.rows);
+                int bottom = Calc::clamp_int(ceil_div (relative.bottom(),   size), 0, grid.rows);
+                int from   = Calc::clamp_int(floor_div(relative.x - (sign < 0 ? steps : 0), size), 0, grid.columns);
+                int to     = Calc::clamp_int(ceil_div (relative.right() + (sign > 0 ? steps : 0), size), 0, grid.columns);
+
+                for (int x = from; top < bottom && x < to; x++) {
+                    if (column_any(grid, x, top, bottom)
+                     && span_run(relative.x, relative.w, x * size, size, sign, steps, lo, hi)) {
+                        fn(lo, hi);
+                    }
+                }
+            } else {
+                int left   = Calc::clamp_int(floor_div(relative.x,          size), 0, grid.columns);
+                int right  = Calc::clamp_int(ceil_div (relative.right(),    size), 0, grid.columns);
+                int from   = Calc::clamp_int(floor_div(relative.y - (sign < 0 ? steps : 0), size), 0, grid.rows);
+                int to     = Calc::clamp_int(ceil_div (relative.bottom() + (sign > 0 ? steps : 0), size), 0, grid.rows);
+
+                for (int y = from; left < right && y < to; y++) {
+                    if (row_any(grid, y, left, right)
+                     && span_run(relative.y, relative.h, y * size, size, sign, steps, lo, hi)) {
+                        fn(lo, hi);
+                    }
+                }
+            }
+        }
+
+        return false;
+    });
+}
+
+template<class F> void Collider::each_sibling(uint32_t mask, F&& fn) const {
+    auto type = Component::type_id<Collider>();
+    for (auto& it : entity()->components()) {
+        if (it != this && it->type() == type && (((const Collider*) it)->m_mask & mask) == mask) {
+            fn((const Collider*) it);
+        }
+    }
+}
+
+void Collider::awake() {
+    broadphase().insert(this);
+}
+
+void Collider::destroyed() {
+    // never woke, if its entity was destroyed before the add went through
+    if (world()) {
+        broadphase().remove(this);
+    }
+}
+
+Broadphase& Collider::broadphase() const {
+    // the broadphase is a cache of the world's colliders, so it's fine
+    // for const queries to use it
+    return const_cast<World*>(world())->service<Broadphase>();
+}
+
+void Collider::debug_render(Batch& batch) const {
     static const Color color = Color::red;
 
-    batch.push_matrix(Mat3x2::create_translation(entity()->position));
+    batch.push_matrix(Mat3x2::create_translation(entity()->render_position()));
 
     if (m_shape == Shape::Rect) {
         batch.rect_line(m_rect, 1, color);
     } else if (m_shape == Shape::Grid) {
         for (int x = 0; x < m_grid.columns; x++) {
             for (int y = 0; y < m_grid.rows; y++) {
-                if (!m_grid.cells[x + y * m_grid.columns])  continue;
+                if (!get_cell(x, y))  continue;
 
                 RectI rect = RectI(x * m_grid.tile_size, y * m_grid.tile_size, m_grid.tile_size, m_grid.tile_size);
                 batch.rect_line(rect, 1, color);
@@ -116,32 +408,75 @@ void Collider::render(Batch& batch) {
     batch.pop_matrix();
 }
 
-bool Collider::rect_to_rect(const Collider *a, const Collider *b, Point offset) {
-    RectI ar = a->m_rect + a->entity()->position + offset;
+bool Collider::rect_overlaps(const RectI& rect, const Collider* other) {
+    if (other->m_shape == Shape::Rect) {
+        return rect_to_rect(rect, other);
+    } else if (other->m_shape == Shape::Grid) {
+        return rect_to_grid(rect, other);
+    }
+
+    return false;
+}
+
+bool Collider::rect_to_rect(const RectI& a, const Collider *b) {
     RectI br = b->m_rect + b->entity()->position;
 
-    return ar.overlaps(br);
+    return a.overlaps(br);
 }
 
-bool Collider::rect_to_grid(const Collider *a, const Collider *b, Point offset) {
+bool Collider::rect_to_grid(const RectI& a, const Collider *b) {
     // get a relative rectangle to the grid
-    RectI rect = a->m_rect + a->entity()->position + offset - b->entity()->position;
+    RectI rect = a - b->entity()->position;
 
     // get the cells the rectangle overlaps
-    int left   = Calc::clamp_int(Calc::floor  (rect.x        / (float) b->m_grid.tile_size), 0, b->m_grid.columns);
-    int right  = Calc::clamp_int(Calc::ceiling(rect.right()  / (float) b->m_grid.tile_size), 0, b->m_grid.columns);
-    int top    = Calc::clamp_int(Calc::floor  (rect.y        / (float) b->m_grid.tile_size), 0, b->m_grid.rows);
-    int bottom = Calc::clamp_int(Calc::ceiling(rect.bottom() / (float) b->m_grid.tile_size), 0, b->m_grid.rows);
-
-    // check each cell
-    for (int x = left; x < right; x++) {
-        for (int y = top; y < bottom; y++) {
-            if (b->m_grid.cells[x + y * b->m_grid.columns]) {
-                return true;
-            }
+    auto& grid = b->m_grid;
+    int left   = Calc::clamp_int(floor_div(rect.x,        grid.tile_size), 0, grid.columns);
+    int right  = Calc::clamp_int(ceil_div (rect.right(),  grid.tile_size), 0, grid.columns);
+    int top    = Calc::clamp_int(floor_div(rect.y,        grid.tile_size), 0, grid.rows);
+    int bottom = Calc::clamp_int(ceil_div (rect.bottom(), grid.tile_size), 0, grid.rows);
+
+    if (left >= right) {
+        return false;
+    }
+
+    for (int y = top; y < bottom; y++) {
+        if (row_any(grid, y, left, right)) {
+            return true;
         }
     }
 
     // all cells were empty
     return false;
 }
+
+bool Collider::row_any(const Grid& grid, int y, int left, int right) {
+    // check the covered bits of the row, a word at a time
+    auto row = grid.words.data() + y * grid.row_words;
+    int first = left / Grid::word_bits;
+    int last = (right - 1) / Grid::word_bits;
+    for (int i = first; i <= last; i++) {
+        int from = (i == first ? left % Grid::word_bits : 0);
+        int to = (i == last ? (right - 1) % Grid::word_bits + 1 : Grid::word_bits);
+        if (row[i] & word_range(from, to)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Collider::column_any(const Grid& grid, int x, int top, int bottom) {
+    auto word = x / Grid::word_bits;
+    auto bit = (uint64_t) 1 << (x % Grid::word_bits);
+    for (int y = top; y < bottom; y++) {
+        if (grid.words[word + y * grid.row_words] & bit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t Collider::word_range(int from, int to) {
+    auto below_to = (to >= Grid::word_bits ? ~(uint64_t) 0 : ((uint64_t) 1 << to) - 1);
+    auto below_from = ((uint64_t) 1 << from) - 1;
+    return below_to & ~below_from;
+}
@@ -1,11 +1,14 @@
 #pragma once
 #include <blah.h>
 #include "../world.h"
+#include "../broadphase.h"
 
 using namespace Blah;
 
 namespace Zen {
     class Collider : public Component {
+        friend class Broadphase;
+
     public:
         enum class Shape {
             None,
@@ -13,8 +16,6 @@ namespace Zen {
             Grid
         };
 
-        uint32_t mask = 0;
-
         Collider();
 
         static Collider make_rect(const RectI& rect);
@@ -22,6 +23,17 @@ namespace Zen {
 
         Shape shape() const;
 
+        // world space bounds of the whole shape
+        RectI bounds() const;
+
+        uint32_t get_mask() const;
+        void set_mask(uint32_t value);
+
+        // static colliders are ones expected to stay put, like a room's
+        // grids and its doors. they still work if they move, just slower
+        bool is_static() const;
+        void set_static(bool value);
+
         RectI get_rect() const;
         void set_rect(const RectI& value);
 
@@ -32,22 +44,69 @@ namespace Zen {
         bool check(uint32_t mask, Point offset = Point::zero) const;
         bool overlaps(const Collider* other, Point offset = Point::zero) const;
 
-        void render(Batch& batch) override;
+        // finds the colliders other than this one that match the mask and
+        // overlap the world space rect, writing up to capacity of them to out.
+        // returns how many there were in total, which can be more than fit
+        int query(uint32_t mask, const RectI& rect, Collider** out, int capacity) const;
+
+        // how many steps this rect can take in the given direction (one pixel
+        // along an axis), up to the given count, before a check of the next
+        // step against the mask would hit something. the same answer as
+        // stepping and checking a pixel at a time, from a single query
+        int sweep(uint32_t mask, Point direction, int steps) const;
+
+        // like sweep, but only stops at colliders that the step before wasn't
+        // already overlapping, which is how one-way platforms are landed on
+        int sweep_onto(uint32_t mask, Point direction, int steps) const;
+
+        void awake() override;
+        void destroyed() override;
+
+        // outlines the collider. colliders aren't drawn by the World, this
+        // is only for the debug view
+        void debug_render(Batch& batch) const;
 
     private:
+        // cells are packed a bit each into rows of 64 bit words, so
+        // a row of cells can be tested or filled a word at a time
         struct Grid {
+            static constexpr int word_bits = 64;
+
             int columns;
             int rows;
             int tile_size;
-            Vector<bool> cells;
+            int row_words;
+            Vector<uint64_t> words;
         };
 
         Shape m_shape = Shape::None;
+        uint32_t m_mask = 0;
+        bool m_static = false;
         RectI m_rect;
         Grid m_grid;
+        Broadphase::Handle m_proxy;
+
+        Broadphase& broadphase() const;
+
+        // world space rect against another collider's shape
+        static bool rect_overlaps(const RectI& rect, const Collider* other);
+        static bool rect_to_rect(const RectI& a, const Collider* b);
+        static bool rect_to_grid(const RectI& a, const Collider* b);
+
+        // whether any cell of a row or column within a range is set
+        static bool row_any(const Grid& grid, int y, int left, int right);
+        static bool column_any(const Grid& grid, int x, int top, int bottom);
+
+        // calls fn(lo, hi) for each run of steps lo..hi (0 being where it is now)
+        // over which this rect would overlap other colliders matching the mask
+        template<class F> void sweep_runs(uint32_t mask, Point direction, int steps, F&& fn) const;
+
+        // calls fn(other) for the other colliders on this one's entity that
+        // match the mask. those move along with it, so they don't sweep
+        template<class F> void each_sibling(uint32_t mask, F&& fn) const;
 
-        static bool rect_to_rect(const Collider* a, const Collider* b, Point offset);
-        static bool rect_to_grid(const Collider* a, const Collider* b, Point offset);
+        // the bits from..to (exclusive) of a word, where from < to
+        static uint64_t word_range(int from, int to);
     };
 
 }
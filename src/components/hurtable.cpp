@@ -1,13 +1,15 @@
 #include "hurtable.h"
+#include "../contacts.h"
 
 using namespace Zen;
 
 void Hurtable::update() {
     if (collider && on_hurt && stun_timer <= 0) {
-        if (collider->check(hurt_by)) {
+        if (world()->service<Contacts>().first(collider, hurt_by)) {
             Time::pause_for(0.1f);
             stun_timer = 0.5f;
             flicker_timer = 0.5f;
+            m_flicker_time = 0;
             on_hurt(this);
         }
     }
@@ -16,8 +18,10 @@ void Hurtable::update() {
 
     if (flicker_timer > 0) {
         flicker_timer -= Time::delta;
+        m_flicker_time += Time::delta;
 
-        if (Time::on_interval(0.05f)) {
+        // timed in steps, so every step of a frame counts
+        if (Time::on_interval(m_flicker_time, Time::delta, 0.05f, 0)) {
             entity()->visible = !entity()->visible;
         }
         if (flicker_timer <= 0) {
@@ -2,7 +2,7 @@
 #include <blah.h>
 #include "collider.h"
 #include "../world.h"
-#include <functional>
+#include "../callback.h"
 
 using namespace Blah;
 
@@ -14,9 +14,13 @@ namespace Zen {
         float flicker_timer = 0;
         Collider* collider = nullptr;
         uint32_t hurt_by = 0;
-        std::function<void(Hurtable* self)> on_hurt;
+        Callback<void(Hurtable* self)> on_hurt;
 
         void update() override;
+
+    private:
+        // how long it's been flickering, counted in steps
+        float m_flicker_time = 0;
     };
 
 }
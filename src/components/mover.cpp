@@ -1,63 +1,86 @@
 #include "mover.h"
 #include "../masks.h"
 
+#include <algorithm>
+
 using namespace Zen;
 
+namespace {
+    Mover::GroundStats stats;
+}
+
 bool Mover::move_x(int amount) {
+    // nothing to sweep, and nothing to re-bucket
+    if (amount == 0) {
+        return false;
+    }
+
     if (collider) {
         int sign = Calc::sign(amount);
+        int steps = amount * sign;
 
-        while (amount != 0) {
-            if (collider->check(Mask::solid, Point(sign, 0))) {
-                if (on_hit_x) {
-                    on_hit_x(this);
-                } else {
-                    stop_x();
-                }
-                return true;
-            }
+        // how far we get before a solid is in the way
+        int free = collider->sweep(Mask::solid, Point(sign, 0), steps);
 
-            amount -= sign;
-            entity()->position.x += sign;
+        // blocked right away, so we're still where we were
+        if (free != 0) {
+            entity()->position.x += free * sign;
+            world()->service<Broadphase>().refresh(entity());
+        }
+
+        if (free < steps) {
+            if (on_hit_x) {
+                on_hit_x(this);
+            } else {
+                stop_x();
+            }
+            return true;
         }
     } else {
         entity()->position.x += amount;
+        world()->service<Broadphase>().refresh(entity());
     }
 
     return false;
 }
 
 bool Mover::move_y(int amount) {
+    // nothing to sweep, and nothing to re-bucket
+    if (amount == 0) {
+        return false;
+    }
+
     if (collider) {
         int sign = Calc::sign(amount);
+        int steps = amount * sign;
 
-        while (amount != 0) {
-            // if hit solid
-            bool hit_something = collider->check(Mask::solid, Point(0, sign));
+        // how far we get before hitting a solid
+        int free = collider->sweep(Mask::solid, Point(0, sign), steps);
 
-            // no solid, but we're moving down, so check for jumpthru
-            // but only if we're not already overlapping a jumpthru
-            if (!hit_something && sign > 0) {
-                auto about_to_overlap_jumpthru        =  collider->check(Mask::jumpthru, Point(0, sign));
-                auto not_already_overlapping_jumpthru = !collider->check(Mask::jumpthru, Point(0, 0));
-                hit_something = (about_to_overlap_jumpthru && not_already_overlapping_jumpthru);
-            }
+        // moving down, we also land on any jumpthru
+        // we weren't already overlapping
+        if (sign > 0) {
+            free = std::min(free, collider->sweep_onto(Mask::jumpthru, Point(0, sign), free));
+        }
 
-            // stop movement
-            if (hit_something) {
-                if (on_hit_y) {
-                    on_hit_y(this);
-                } else {
-                    stop_y();
-                }
-                return true;
-            }
+        // blocked right away, so we're still where we were
+        if (free != 0) {
+            entity()->position.y += free * sign;
+            world()->service<Broadphase>().refresh(entity());
+        }
 
-            amount -= sign;
-            entity()->position.y += sign;
+        // stop movement
+        if (free < steps) {
+            if (on_hit_y) {
+                on_hit_y(this);
+            } else {
+                stop_y();
+            }
+            return true;
         }
     } else {
         entity()->position.y += amount;
+        world()->service<Broadphase>().refresh(entity());
     }
 
     return false;
@@ -85,6 +108,22 @@ bool Mover::on_ground(int dist) const{
         return false;
     }
 
+    // the usual one pixel down is cached
+    if (dist == 1) {
+        validate_ground();
+        if (m_ground.ground >= 0) {
+            stats.saved += 3;
+            return m_ground.ground;
+        }
+
+        auto about_to_overlap_jumpthru        =  collider->check(Mask::jumpthru, Point(0, 1));
+        auto not_already_overlapping_jumpthru = !collider->check(Mask::jumpthru, Point(0, 0));
+        stats.checks += 2;
+
+        m_ground.ground = solid_below() || (about_to_overlap_jumpthru && not_already_overlapping_jumpthru);
+        return m_ground.ground;
+    }
+
     auto about_to_overlap_jumpthru        =  collider->check(Mask::jumpthru, Point(0, dist));
     auto not_already_overlapping_jumpthru = !collider->check(Mask::jumpthru, Point(0, 0));
     auto hit_jumpthru = (about_to_overlap_jumpthru && not_already_overlapping_jumpthru);
@@ -94,6 +133,42 @@ bool Mover::on_ground(int dist) const{
     return hit_solid || hit_jumpthru;
 }
 
+Mover::GroundStats Mover::ground_stats() {
+    return stats;
+}
+
+void Mover::reset_ground_stats() {
+    stats = GroundStats();
+}
+
+void Mover::validate_ground() const {
+    auto& broadphase = const_cast<World*>(world())->service<Broadphase>();
+    auto version = broadphase.version(Mask::solid | Mask::jumpthru);
+    auto bounds = collider->bounds();
+
+    if (m_ground.collider != collider || m_ground.version != version
+     || m_ground.bounds.x != bounds.x || m_ground.bounds.y != bounds.y
+     || m_ground.bounds.w != bounds.w || m_ground.bounds.h != bounds.h) {
+        m_ground.collider = collider;
+        m_ground.bounds = bounds;
+        m_ground.version = version;
+        m_ground.solid = -1;
+        m_ground.ground = -1;
+    }
+}
+
+bool Mover::solid_below() const {
+    validate_ground();
+    if (m_ground.solid >= 0) {
+        stats.saved += 1;
+        return m_ground.solid;
+    }
+
+    stats.checks += 1;
+    m_ground.solid = collider->check(Mask::solid, Point(0, 1));
+    return m_ground.solid;
+}
+
 void Mover::update() {
     // apply friction maybe
     if (friction > 0 && on_ground()) {
@@ -101,7 +176,7 @@ void Mover::update() {
     }
 
     // apply gravity
-    if (gravity != 0 && (!collider || !collider->check(Mask::solid, Point(0, 1)))) {
+    if (gravity != 0 && (!collider || !solid_below())) {
         speed.y += gravity * Time::delta;
     }
 
@@ -2,23 +2,45 @@
 #include <blah.h>
 #include "collider.h"
 #include "../world.h"
-#include <functional>
+#include "../callback.h"
 
 using namespace Blah;
 
 namespace Zen {
 
     class Mover : public Component {
+    public:
+        // how many collider checks ground contact took, and how many
+        // the cache saved, since the stats were last reset
+        struct GroundStats {
+            int64_t checks = 0;
+            int64_t saved = 0;
+        };
+
     private:
+        // ground contact, kept until the collider or a solid or jumpthru
+        // changes (see Broadphase::version). -1 is not worked out yet
+        struct Ground {
+            const Collider* collider = nullptr;
+            RectI bounds;
+            uint32_t version = 0;
+            int solid = -1;
+            int ground = -1;
+        };
+
         Vec2 m_remainder;
+        mutable Ground m_ground;
+
+        void validate_ground() const;
+        bool solid_below() const;
 
     public:
         Collider* collider = nullptr;
         Vec2 speed;
         float gravity = 0;
         float friction = 0;
-        std::function<void(Mover*)> on_hit_x;
-        std::function<void(Mover*)> on_hit_y;
+        Callback<void(Mover*)> on_hit_x;
+        Callback<void(Mover*)> on_hit_y;
 
         bool move_x(int amount);
         bool move_y(int amount);
@@ -29,6 +51,9 @@ namespace Zen {
 
         bool on_ground(int dist = 1) const;
 
+        static GroundStats ground_stats();
+        static void reset_ground_stats();
+
         void update() override;
 
     };
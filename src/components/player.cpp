@@ -2,6 +2,8 @@
 #include "mover.h"
 #include "animator.h"
 #include "../masks.h"
+#include "../replay.h"
+#include "../contacts.h"
 
 using namespace Zen;
 
@@ -38,17 +40,31 @@ Player::Player() {
             .add_key(Key::Z)
             .add_button(0, Button::X);
 }
-void Player::update() {
+
+void Player::latch_input() {
     input_move.update();
     input_jump.update();
     input_attack.update();
 
+    m_input.move_x = input_move.value_i().x;
+    m_input.jump_down = input_jump.down();
+    m_input.jump_pressed = m_input.jump_pressed || input_jump.pressed();
+    m_input.attack_pressed = m_input.attack_pressed || input_attack.pressed();
+}
+
+void Player::update() {
+    // recordings capture what the player saw this step, and playback replaces it.
+    // a press is only seen by one step, later steps of the frame get the held state
+    auto frame = Replay::input(m_input);
+    m_input.jump_pressed = false;
+    m_input.attack_pressed = false;
+
     auto mover = get<Mover>();
     auto anim = get<Animator>();
     auto hitbox = get<Collider>();
     auto was_on_ground = m_on_ground;
     m_on_ground = mover->on_ground();
-    int input = input_move.value_i().x;
+    int input = frame.move_x;
 
     // sprite stuff
     {
@@ -115,7 +131,7 @@ void Player::update() {
         // invoke jumping
         {
             // do the jump
-            if (input_jump.pressed() && m_on_ground) {
+            if (frame.jump_pressed && m_on_ground) {
                 input_jump.clear_press_buffer();
 
                 // squoosh on jomp
@@ -128,7 +144,7 @@ void Player::update() {
         }
 
         // begin attacking
-        if (input_attack.pressed()) {
+        if (frame.attack_pressed) {
             input_attack.clear_press_buffer();
 
             m_state = st_attack;
@@ -136,7 +152,7 @@ void Player::update() {
 
             if (!m_attack_collider) {
                 m_attack_collider = entity()->add(Collider::make_rect(RectI()));
-                m_attack_collider->mask = Mask::player_attack;
+                m_attack_collider->set_mask(Mask::player_attack);
             }
 
             if (m_on_ground) {
@@ -209,15 +225,16 @@ void Player::update() {
 
         mover->speed.y = jump_force;
 
-        if (!input_jump.down()) {
+        if (!frame.jump_down) {
             m_jump_timer = 0;
         }
     }
 
     // invincible timer
     if (m_state != st_hurt && m_invincible_timer > 0) {
-        // flicker animation
-        if (Time::on_interval(0.05f)) {
+        // flicker animation, timed in steps so every step of a frame counts
+        m_flicker_time += Time::delta;
+        if (Time::on_interval(m_flicker_time, Time::delta, 0.05f, 0)) {
             anim->visible = !anim->visible;
         }
 
@@ -231,7 +248,7 @@ void Player::update() {
     if (!m_on_ground) {
         // make gravity more 'hovery' when in the air
         float grav = gravity;
-        if (m_state == st_normal && Calc::abs(mover->speed.y) < 20 && input_jump.down()) {
+        if (m_state == st_normal && Calc::abs(mover->speed.y) < 20 && frame.jump_down) {
             grav *= 0.4f;
         }
 
@@ -239,7 +256,7 @@ void Player::update() {
     }
 
     // hurt check (could be done with hurtable component)
-    if (m_invincible_timer <= 0 && hitbox->check(Mask::enemy)) {
+    if (m_invincible_timer <= 0 && world()->service<Contacts>().first(hitbox, Mask::enemy)) {
         Time::pause_for(0.1f);
         anim->play("hurt");
 
@@ -254,6 +271,7 @@ void Player::update() {
         health -= 1;
         m_hurt_timer = hurt_duration;
         m_invincible_timer = invincible_duration;
+        m_flicker_time = 0;
         m_state = st_hurt;
     }
 }
@@ -2,6 +2,7 @@
 #include <blah.h>
 #include "collider.h"
 #include "../world.h"
+#include "../replay.h"
 
 using namespace Blah;
 
@@ -25,6 +26,10 @@ namespace Zen {
 
         Player();
 
+        // reads the controls, once per rendered frame. presses are held on
+        // to until a step sees them, since a frame can run several steps or none
+        void latch_input();
+
         void update() override;
 
     private:
@@ -34,9 +39,11 @@ namespace Zen {
         float m_attack_timer = 0;
         float m_hurt_timer = 0;
         float m_invincible_timer = 0;
+        float m_flicker_time = 0;
         float m_start_timer = 0;
         float m_on_ground = false;
         Collider* m_attack_collider = nullptr;
+        InputFrame m_input;
     };
 
 }
@@ -2,20 +2,136 @@
 
 using namespace Zen;
 
-Timer::Timer(float duration, const std::function<void(Timer* self)>& on_end)
-    : m_duration(duration), on_end(on_end)
+// the timers that came due while inactive, checked before each update.
+// usually empty, so it costs nothing unless something is paused
+struct Timer::Parked {
+    Vector<Timer*> timers;
+
+    void before_update() {
+        for (int i = 0; i < timers.size();) {
+            auto timer = timers[i];
+            if (timer->active && timer->entity()->active) {
+                // fires when the wheel advances at the end of this update
+                timer->unpark();
+                timer->schedule(timer->world()->timers().tick() + 1);
+            } else {
+                i++;
+            }
+        }
+    }
+};
+
+Timer::Timer(float duration, Callback<void(Timer* self)> on_end)
+    : on_end(std::move(on_end)), m_duration(duration)
+{
+}
+
+Timer::Timer(const Timer& other)
+    : Component(other), on_end(other.on_end), m_duration(other.m_duration), m_parked(other.m_parked), m_due(other.m_due)
 {
 }
 
+Timer& Timer::operator=(const Timer& other) {
+    BLAH_ASSERT(m_handle < 0 && !(m_parked && m_awake), "Cannot assign to a Timer that is waiting in a World");
+    Component::operator=(other);
+    on_end = other.on_end;
+    m_duration = other.m_duration;
+    m_parked = other.m_parked;
+    m_due = other.m_due;
+    return *this;
+}
+
 void Timer::start(float duration) {
-    m_duration = duration;
+    // not in a world yet, or added during an update and still waiting on a
+    // sync point, so start counting once it wakes. a pending timer's entity
+    // can still be destroyed before then, and it mustn't be in the wheel
+    if (!m_awake) {
+        m_duration = duration;
+        m_parked = false;
+        m_due = 0;
+        return;
+    }
+
+    cancel();
+    unpark();
+    if (duration > 0) {
+        schedule(world()->timers().due_after(duration));
+    }
+}
+
+void Timer::awake() {
+    m_awake = true;
+
+    // a timer copied out of a snapshot picks up where it left off
+    if (m_parked) {
+        m_parked = false;
+        park();
+    } else if (m_due > 0) {
+        schedule(m_due);
+    } else if (m_duration > 0) {
+        schedule(world()->timers().due_after(m_duration));
+    }
+    m_duration = 0;
+}
+
+void Timer::destroyed() {
+    cancel();
+    unpark();
+    m_awake = false;
+}
+
+void Timer::fire(Component* component) {
+    auto timer = (Timer*) component;
+    timer->m_handle = -1;
+    timer->m_due = 0;
+
+    // destroyed, but not removed until the next sync point
+    if (timer->is_destroyed()) {
+        return;
+    }
+
+    // paused along with its component or entity, so it waits off the
+    // wheel until it's active again
+    if (!timer->active || !timer->entity()->active) {
+        timer->park();
+        return;
+    }
+
+    if (timer->on_end) {
+        timer->on_end(timer);
+    }
+}
+
+void Timer::schedule(uint64_t due) {
+    m_handle = world()->timers().schedule(this, &Timer::fire, due);
+    m_due = due;
+}
+
+void Timer::cancel() {
+    if (m_handle >= 0) {
+        world()->timers().cancel(m_handle);
+        m_handle = -1;
+    }
+    m_due = 0;
+}
+
+void Timer::park() {
+    if (!m_parked) {
+        world()->service<Parked>().timers.push_back(this);
+        m_parked = true;
+    }
 }
 
-void Timer::update() {
-   if (m_duration > 0) {
-       m_duration -= Time::delta;
-       if (m_duration <= 0 && on_end) {
-           on_end(this);
-       }
-   }
+void Timer::unpark() {
+    // a copy that never woke isn't on the World's list
+    if (m_parked && m_awake) {
+        auto& timers = world()->service<Parked>().timers;
+        for (int i = 0; i < timers.size(); i++) {
+            if (timers[i] == this) {
+                timers.erase(i);
+                break;
+            }
+        }
+    }
+    m_parked = false;
 }
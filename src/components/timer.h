@@ -1,26 +1,56 @@
 #pragma once
 #include <blah.h>
 #include "../world.h"
-#include <functional>
+#include "../callback.h"
 
 using namespace Blah;
 
 namespace Zen {
 
+    // A handle on an entry in the World's timer wheel. Nothing happens per
+    // update while it waits, the wheel calls on_end once the time is up.
+    // Unlike a countdown in update(), time keeps passing while the timer or
+    // its entity is inactive. One that comes due while inactive is set aside,
+    // off the wheel, and fires on the first update it's active again.
     class Timer : public Component {
-    private:
-        float m_duration = 0;
-
     public:
         Timer() = default;
-        Timer(float duration, const std::function<void(Timer* self)>& on_end = nullptr);
+        Timer(float duration, Callback<void(Timer* self)> on_end = nullptr);
+
+        // copies keep the timer's due time but not its place in the wheel,
+        // which is taken again when the copy is added to a World
+        Timer(const Timer& other);
+        Timer& operator=(const Timer& other);
 
         void start(float duration);
 
-        std::function<void(Timer* self)> on_end;
+        Callback<void(Timer* self)> on_end;
+
+        void awake() override;
+        void destroyed() override;
+
+    private:
+        struct Parked;
+
+        static void fire(Component* component);
+
+        void schedule(uint64_t due);
+        void cancel();
+        void park();
+        void unpark();
+
+        // a duration that starts counting once the timer is in a World
+        float m_duration = 0;
 
-        void update() override;
+        // between awake() and destroyed(), the only time it can be in the wheel
+        bool m_awake = false;
+
+        // came due while inactive, and waiting to be active again
+        bool m_parked = false;
+
+        // the wheel tick the timer is due on, or 0 if it isn't waiting
+        uint64_t m_due = 0;
+        int m_handle = -1;
     };
 
 }
-
@@ -0,0 +1,112 @@
+#include "contacts.h"
+#include "masks.h"
+#include "components/collider.h"
+#include "components/hurtable.h"
+#include "components/player.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    bool before(const Collider* a, uint32_t a_mask, const Collider* b, uint32_t b_mask) {
+        return (a != b ? std::less<const Collider*>()(a, b) : a_mask < b_mask);
+    }
+
+}
+
+int Contacts::hits(const Collider* collider, uint32_t mask, Collider** out, int capacity) {
+    BLAH_ASSERT(collider->shape() == Collider::Shape::Rect, "Collider is not a Rectangle!");
+
+    // only the layers the pass looked for matter, so movers elsewhere
+    // (like the player's own collider) don't throw it away
+    auto world = const_cast<World*>(collider->world());
+    auto& broadphase = world->service<Broadphase>();
+    if (!m_valid || m_version != broadphase.version(m_layers)) {
+        refresh(world);
+        m_version = broadphase.version(m_layers);
+        m_valid = true;
+    }
+
+    // colliders that weren't around for the pass, that moved since, or that
+    // were hit by more than the pass kept, are looked up directly
+    auto entry = find(collider, mask);
+    auto bounds = collider->bounds();
+    if (!entry
+     || entry->bounds.x != bounds.x || entry->bounds.y != bounds.y
+     || entry->bounds.w != bounds.w || entry->bounds.h != bounds.h
+     || (entry->count > max_hits && capacity > max_hits)) {
+        return collider->query(mask, bounds, out, capacity);
+    }
+
+    int count = std::min(std::min(entry->count, max_hits), capacity);
+    for (int i = 0; i < count; i++) {
+        out[i] = m_hits[entry->first + i];
+    }
+    return entry->count;
+}
+
+Collider* Contacts::first(const Collider* collider, uint32_t mask) {
+    Collider* hit;
+    return (hits(collider, mask, &hit, 1) > 0 ? hit : nullptr);
+}
+
+void Contacts::refresh(World* world) {
+    m_entries.clear();
+    m_hits.clear();
+    m_layers = 0;
+
+    for (auto it = world->first<Hurtable>(); it; it = (Hurtable*) it->next()) {
+        if (it->collider) {
+            add(it->collider, it->hurt_by);
+        }
+    }
+
+    for (auto it = world->first<Player>(); it; it = (Player*) it->next()) {
+        if (auto hitbox = it->get<Collider>()) {
+            add(hitbox, Mask::enemy);
+        }
+    }
+
+    // sorted so lookups can search for their entry
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        return before(a.collider, a.mask, b.collider, b.mask);
+    });
+}
+
+void Contacts::add(const Collider* collider, uint32_t mask) {
+    if (collider->shape() != Collider::Shape::Rect) {
+        return;
+    }
+
+    Collider* found[max_hits];
+    auto bounds = collider->bounds();
+    int count = collider->query(mask, bounds, found, max_hits);
+    m_layers |= mask;
+
+    Entry entry;
+    entry.collider = collider;
+    entry.bounds = bounds;
+    entry.mask = mask;
+    entry.first = m_hits.size();
+    entry.count = count;
+    m_entries.push_back(entry);
+
+    for (int i = 0; i < std::min(count, max_hits); i++) {
+        m_hits.push_back(found[i]);
+    }
+}
+
+const Contacts::Entry* Contacts::find(const Collider* collider, uint32_t mask) const {
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), collider, [mask](const Entry& entry, const Collider* value) {
+        return before(entry.collider, entry.mask, value, mask);
+    });
+
+    if (it != m_entries.end() && it->collider == collider && it->mask == mask) {
+        return it;
+    }
+    return nullptr;
+}
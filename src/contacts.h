@@ -0,0 +1,50 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+
+using namespace Blah;
+
+namespace Zen {
+
+    class World;
+    class Collider;
+
+    // The hurt checks of an update, worked out together (see World::service).
+    // The first lookup runs one pass over every Hurtable and Player, finding
+    // what overlaps each of them, and the rest read from it. The pass runs
+    // again once a collider on one of the layers they look for has changed
+    // (see Broadphase::version), and a collider that moved since the pass is
+    // looked up directly, so lookups give the same answers a check would.
+    class Contacts {
+    public:
+        // how many hits are kept per lookup, past that they're looked up directly
+        static constexpr int max_hits = 8;
+
+        // writes up to capacity of the colliders matching the mask that overlap
+        // the given rect collider to out, returning how many there are in total
+        int hits(const Collider* collider, uint32_t mask, Collider** out, int capacity);
+
+        // the first collider matching the mask that overlaps the given one, if any
+        Collider* first(const Collider* collider, uint32_t mask);
+
+    private:
+        struct Entry {
+            const Collider* collider;
+            RectI bounds;
+            uint32_t mask;
+            int first;
+            int count;
+        };
+
+        void refresh(World* world);
+        void add(const Collider* collider, uint32_t mask);
+        const Entry* find(const Collider* collider, uint32_t mask) const;
+
+        Vector<Entry> m_entries;
+        Vector<Collider*> m_hits;
+        uint32_t m_layers = 0;
+        uint32_t m_version = 0;
+        bool m_valid = false;
+    };
+
+}
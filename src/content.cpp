@@ -44,13 +44,15 @@ FilePath Content::path() {
     return root;
 }
 
-void Content::load() {
+void Content::load(bool headless) {
     Packer packer;
     packer.padding = 0;
 
     // load the main font
-    font = SpriteFont(path() + "fonts/dogica.ttf", 8, SpriteFont::ASCII);
-    font.line_gap = 4;
+    if (!headless) {
+        font = SpriteFont(path() + "fonts/dogica.ttf", 8, SpriteFont::ASCII);
+        font.line_gap = 4;
+    }
 
     // load sprites
     Vector<SpriteInfo> sprite_info;
@@ -106,7 +108,9 @@ void Content::load() {
     // build the atlas
     {
         packer.pack();
-        sprite_atlas = Texture::create(packer.pages[0]);
+        if (!headless) {
+            sprite_atlas = Texture::create(packer.pages[0]);
+        }
 
         subtextures.expand(packer.entries.size());
         for (auto& entry : packer.entries) {
@@ -16,7 +16,8 @@ namespace Zen {
         static SpriteFont font;
 
         static FilePath path();
-        static void load();
+        // headless loads skip the font and never create GPU textures
+        static void load(bool headless = false);
         static void unload();
         static TextureRef atlas();
 
@@ -7,6 +7,7 @@
 #include "components/enemy.h"
 #include "components/hurtable.h"
 #include "components/timer.h"
+#include "components/tilemap.h"
 
 using namespace Zen;
 
@@ -35,7 +36,7 @@ Entity* Factory::bramble(World* world, Point position) {
     anim->depth = -5;
 
     auto hitbox = en->add(Collider::make_rect(RectI(-4, -8, 8, 8)));
-    hitbox->mask = Mask::enemy;
+    hitbox->set_mask(Mask::enemy);
 
     auto hurtable = en->add(Hurtable());
     hurtable->hurt_by = Mask::player_attack;
@@ -72,7 +73,7 @@ Entity* Factory::spitter(World* world, Point position) {
     anim->depth = -5;
 
     auto hitbox = en->add(Collider::make_rect(RectI(-8, -12, 13, 12)));
-    hitbox->mask = Mask::enemy;
+    hitbox->set_mask(Mask::enemy);
 
     auto hurtable = en->add(Hurtable());
     hurtable->hurt_by = Mask::player_attack;
@@ -91,7 +92,10 @@ Entity* Factory::spitter(World* world, Point position) {
         bullet(self->world(), self->entity()->position + Point(-8, -8), -1);
 
         self->get<Animator>()->play("shoot");
-        self->entity()->add(Timer(0.4f, [](Timer* self) { self->get<Animator>()->play("idle"); }));
+        self->entity()->add(Timer(0.4f, [](Timer* self) {
+            self->get<Animator>()->play("idle");
+            self->destroy();
+        }));
         self->start(3.0f);
     }));
 
@@ -106,7 +110,7 @@ Entity* Factory::bullet(World* world, Point position, int direction) {
     anim->depth = -5;
 
     auto hitbox = en->add(Collider::make_rect(RectI(-4, -4, 8, 8)));
-    hitbox->mask = Mask::enemy;
+    hitbox->set_mask(Mask::enemy);
 
     auto mover = en->add(Mover());
     mover->collider = hitbox;
@@ -196,7 +200,7 @@ Entity *Factory::mosquito(World *world, Point position) {
     anim->depth = -5;
 
     auto hitbox = en->add(Collider::make_rect(RectI(-7, -4, 15, 8)));
-    hitbox->mask = Mask::enemy;
+    hitbox->set_mask(Mask::enemy);
 
     auto hurtable = en->add(Hurtable());
     hurtable->hurt_by = Mask::player_attack;
@@ -213,7 +217,8 @@ namespace {
         anim->depth = -1;
 
         auto hitbox = en->add(Collider::make_rect(RectI(-6, -16, 12, 16)));
-        hitbox->mask = Mask::solid;
+        hitbox->set_mask(Mask::solid);
+        hitbox->set_static(true);
     }
 }
 
@@ -256,7 +261,7 @@ Entity* Factory::blob(World* world, Point position) {
     anim->depth = -5;
 
     auto hitbox = en->add(Collider::make_rect(RectI(-7, -13, 14, 13)));
-    hitbox->mask = Mask::enemy;
+    hitbox->set_mask(Mask::enemy);
 
     auto mover = en->add(Mover());
     mover->collider = hitbox;
@@ -311,3 +316,15 @@ Entity* Factory::blob(World* world, Point position) {
 
     return en;
 }
+
+void Factory::register_types() {
+    Component::register_type<Tilemap>("Tilemap");
+    Component::register_type<Collider>("Collider");
+    Component::register_type<Animator>("Animator");
+    Component::register_type<Mover>("Mover");
+    Component::register_type<Player>("Player");
+    Component::register_type<Enemy>("Enemy");
+    Component::register_type<Hurtable>("Hurtable");
+    Component::register_type<Timer>("Timer");
+    Component::register_type<MosquitoBehavior>("MosquitoBehavior");
+}
@@ -7,6 +7,9 @@ using namespace Blah;
 namespace Zen {
 
     namespace Factory {
+        // gives every component type its id, which is also its update order
+        void register_types();
+
         Entity* player(World* world, Point position);
         Entity* bramble(World* world, Point position);
         Entity* pop(World* world, Point position);
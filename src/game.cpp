@@ -2,6 +2,8 @@
 #include "masks.h"
 #include "content.h"
 #include "factory.h"
+#include "replay.h"
+#include "profiler.h"
 #include "components/player.h"
 #include "components/tilemap.h"
 #include "components/mover.h"
@@ -30,8 +32,19 @@ void Game::load_room(Point cell, bool is_reload) {
     // add a floor
     auto floor = world.add_entity(offset);
     auto tilemap = floor->add(Tilemap(8, 8, columns, rows));
-    auto solids = floor->add(Collider::make_grid(8, 40, 23));
-    solids->mask = Mask::solid;
+
+    // the grids are filled in before they're added, so the broadphase
+    // hears about each one once instead of once per cell
+    auto solids = Collider::make_grid(8, 40, 23);
+    solids.set_mask(Mask::solid);
+    solids.set_static(true);
+
+    // jumpthrus cover the top half of their tile, so they all fit in one
+    // grid of half size cells, added when the room has any
+    auto jumpthrus = Collider::make_grid(tile_width / 2, columns * 2, rows * 2);
+    jumpthrus.set_mask(Mask::jumpthru);
+    jumpthrus.set_static(true);
+    bool has_jumpthrus = false;
 
     // loop over the room grid
     for (int x = 0; x < columns; x++) {
@@ -48,7 +61,7 @@ void Game::load_room(Point cell, bool is_reload) {
                 // castle is white
                 case 0xffffff: {
                     tilemap->set_cell(x, y, &castle->random_tile());
-                    solids->set_cell(x, y, true);
+                    solids.set_cell(x, y, true);
                 } break;
 
                 // background is purpleish
@@ -59,15 +72,14 @@ void Game::load_room(Point cell, bool is_reload) {
                 // jumpthru platform is orange
                 case 0xdf7126: {
                     tilemap->set_cell(x, y, &jumpthru->random_tile());
-                    auto jumpthru_en = world.add_entity(offset + Point(x * tile_width, y * tile_height));
-                    auto jumpthru_col = jumpthru_en->add(Collider::make_rect(RectI(0, 0, 8, 4)));
-                    jumpthru_col->mask = Mask::jumpthru;
+                    jumpthrus.set_cells(x * 2, y * 2, 2, 1, true);
+                    has_jumpthrus = true;
                 } break;
 
                 // grass is pale green
                 case 0x8f974a: {
                     tilemap->set_cell(x, y, &grass->random_tile());
-                    solids->set_cell(x, y, true);
+                    solids.set_cell(x, y, true);
                 } break;
 
                 // plants (not solid) are dark green
@@ -116,18 +128,53 @@ void Game::load_room(Point cell, bool is_reload) {
             }
         }
     }
+
+    floor->add(std::move(solids));
+    if (has_jumpthrus) {
+        floor->add(std::move(jumpthrus));
+    }
+}
+
+void Game::reload_room() {
+    // the first reload of a room builds it from scratch and snapshots the
+    // result, after that reloads restore straight from the snapshot
+    if (world.has_snapshot() && m_snapshot_room == room) {
+        ZEN_PROFILE("Game::reload_room restore");
+        world.restore();
+    } else {
+        ZEN_PROFILE("Game::reload_room rebuild");
+        world.clear();
+        load_room(room, true);
+        world.snapshot();
+        m_snapshot_room = room;
+    }
 }
 
 void Game::startup() {
     // load assets
-    Content::load();
+    Content::load(headless);
+
+    // fix the component type ids before anything uses them
+    Factory::register_types();
 
     // create framebuffer for the game
-    buffer = FrameBuffer::create(width, height);
+    if (!headless) {
+        buffer = FrameBuffer::create(width, height);
+    }
 
     // set batch to use nearest filtering
     batch.default_sampler = TextureSampler(TextureFilter::Nearest);
 
+    // timers count in the same steps the world is updated in
+    world.timers().set_tick_duration(fixed_step_duration);
+
+    // give memory back after a few quiet seconds, and catch anything that
+    // keeps piling components onto an entity
+    World::CachePolicy policy;
+    policy.idle_updates = (int) (5 * fixed_step_rate);
+    policy.growth_check_interval = (int) fixed_step_rate;
+    world.set_cache_policy(policy);
+
     // set flags
     m_draw_colliders = false;
     m_frame_by_frame = false;
@@ -135,39 +182,96 @@ void Game::startup() {
     // camera setup
     load_room(Point(13, 0));
     camera = Vec2(room.x * width, room.y * height);
+    m_last_camera = camera;
 }
 
 void Game::shutdown() {
+    // save any input that was being recorded
+    Replay::stop();
+
+    // report frame timings, if they were being collected
+    Profiler::stop();
+
     // unload assets
     Content::unload();
 }
 
 void Game::update() {
-    // quick exit
-    if (Input::pressed(Key::Escape)) {
-        App::exit();
+    Profiler::frame();
+    ZEN_PROFILE("Game::update");
+
+    // there is no window to read keys from when running headless
+    if (!headless) {
+        // quick exit
+        if (Input::pressed(Key::Escape)) {
+            App::exit();
+        }
+
+        // toggle collider render
+        if (Input::pressed(Key::F1)) {
+            m_draw_colliders = !m_draw_colliders;
+        }
+
+        // log what the world's caches are holding on to, and what the
+        // ground contact cache has saved since the last time
+        if (Input::pressed(Key::F3)) {
+            world.log_stats();
+
+            auto ground = Mover::ground_stats();
+            Log::print("Ground contact: %i collider checks, %i saved", (int) ground.checks, (int) ground.saved);
+            Mover::reset_ground_stats();
+        }
+
+        // if flag is enabled, press F12 to progress a frame at a time
+        if (m_frame_by_frame && !Input::pressed(Key::F12)) {
+            return;
+        }
+
+        // reload current room, unless that would throw a replay out of sync
+        if (Input::pressed(Key::F2) && Replay::mode() == Replay::Mode::Off) {
+            // not transitioning
+            m_transition = false;
+            // destroy all entities and reload room
+            reload_room();
+        }
     }
 
-    // toggle collider render
-    if (Input::pressed(Key::F1)) {
-        m_draw_colliders = !m_draw_colliders;
+    // input only exists for the frame it happened in, so it's read here once
+    // rather than by each step. nothing reads it during a transition
+    if (!m_transition) {
+        for (auto it = world.first<Player>(); it; it = (Player*) it->next()) {
+            it->latch_input();
+        }
     }
 
-    // if flag is enabled, press F12 to progress a frame at a time
-    if (m_frame_by_frame && !Input::pressed(Key::F12)) {
+    // frame by frame mode runs a single step per F12 press
+    if (m_frame_by_frame) {
+        step(fixed_step_duration);
+        m_interpolation = 1.0f;
         return;
     }
 
-    // reload current room
-    if (Input::pressed(Key::F2)) {
-        // not transitioning
-        m_transition = false;
-        // destroy all entities
-        world.clear();
-        // reload room
-        load_room(room);
+    // run as many fixed steps as the elapsed time calls for. if we fall
+    // too far behind, drop the extra time rather than trying to catch up
+    m_accumulator = Calc::min(m_accumulator + Time::delta, max_steps_per_frame * fixed_step_duration);
+    while (m_accumulator >= fixed_step_duration - step_tolerance) {
+        m_accumulator -= fixed_step_duration;
+        step(fixed_step_duration);
     }
 
+    // how far the leftover time is into the next step, for rendering
+    m_interpolation = Calc::clamp(m_accumulator / fixed_step_duration, 0.0f, 1.0f);
+}
+
+void Game::step(float delta) {
+    // components read the step length from Time::delta like any other frame
+    auto frame_delta = Time::delta;
+    Time::delta = delta;
+    m_last_camera = camera;
+    Replay::step();
+
+    ZEN_PROFILE("Game::step");
+
     // normal update
     if (!m_transition) {
         world.update();
@@ -187,6 +291,7 @@ void Game::update() {
                 auto next_room_exists = Content::find_room(next_room);
                 auto next_room_is_forward = next_room.x >= room.x;
                 if (player_is_alive && next_room_exists && next_room_is_forward) {
+                    ZEN_PROFILE("Game::step room transition");
                     Time::pause_for(0.1f);
 
                     // transition to next room
@@ -203,7 +308,8 @@ void Game::update() {
                         e = e->next();
                     }
 
-                    // load contents of the next room
+                    // load contents of the next room, the last room's snapshot is no use now
+                    world.discard_snapshot();
                     load_room(next_room);
                 } else {
                     // no next room, keep player in this room
@@ -213,8 +319,7 @@ void Game::update() {
 
                     // reload if they fell out the bottom
                     if (player->entity()->position.y > bounds.y + bounds.h + 64) {
-                        world.clear();
-                        load_room(room, true);
+                        reload_room();
                     }
                 }
             }
@@ -222,10 +327,11 @@ void Game::update() {
             // death ... delete everything except the player
             // then the player falls out of the room causing the room to reload
             if (player->health <= 0) {
+                ZEN_PROFILE("Game::step death sweep");
                 auto e = world.first_entity();
                 while (e) {
                     auto next = e->next();
-                    if (!e->get<Player>()) {
+                    if (!e->has<Player>()) {
                         world.destroy_entity(e);
                     }
                     e = next;
@@ -235,6 +341,8 @@ void Game::update() {
     }
     // room transition
     else {
+        ZEN_PROFILE("Game::step room transition");
+
         // increment ease
         m_next_ease = Calc::approach(m_next_ease, 1.0f, Time::delta / transition_duration);
 
@@ -257,7 +365,7 @@ void Game::update() {
 
             // delete old objects (except player)
             for (auto& it : m_last_entities) {
-                if (it->get<Player>()) continue;
+                if (it->has<Player>()) continue;
                 world.destroy_entity(it);
             }
 
@@ -265,24 +373,33 @@ void Game::update() {
             m_transition = false;
         }
     }
+
+    Time::delta = frame_delta;
 }
 
 void Game::render() {
+    ZEN_PROFILE("Game::render");
+
     // draw gameplay stuff
     {
         buffer->clear(0x150e22);
 
+        // blend between the last two steps. entities don't move during
+        // a room transition, only the camera does
+        auto render_camera = m_last_camera + (camera - m_last_camera) * m_interpolation;
+        auto entity_interpolation = (m_transition ? 1.0f : m_interpolation);
+
         // push camera offset
-        batch.push_matrix(Mat3x2::create_translation(-camera));
+        batch.push_matrix(Mat3x2::create_translation(-render_camera));
         {
             // draw gameplay objects
-            world.render(batch);
+            world.render(batch, entity_interpolation);
 
             // draw debug colliders
             if (m_draw_colliders) {
                 auto collider = world.first<Collider>();
                 while (collider) {
-                    collider->render(batch);
+                    collider->debug_render(batch);
                     collider = (Collider *) collider->next();
                 }
             }
@@ -328,6 +445,7 @@ void Game::render() {
         }
 
         // draw to gameplay buffer
+        ZEN_PROFILE("Game::render batch");
         batch.render(buffer);
         batch.clear();
     }
@@ -16,10 +16,18 @@ namespace Zen {
         static constexpr int columns = width / tile_width;
         static constexpr int rows = height / tile_height + 1;
 
+        // the simulation runs in fixed steps, decoupled from the frame rate
+        static constexpr float fixed_step_rate = 120.0f;
+        static constexpr float fixed_step_duration = 1.0f / fixed_step_rate;
+        static constexpr int max_steps_per_frame = 8;
+
         static inline const char* title = "SWORD II: DONK'S ADVENTURE";
         static inline const char* controls = "arrow keys + X / Z\nstick + A / X";
         static inline const char* ending = "YOU SAVED DONK\nAND YOU ARE\nA REAL DONKIN' HERO";
 
+        // runs without a window or graphics, see headless.cpp
+        bool headless = false;
+
         World world;
         FrameBufferRef buffer;
         Batch batch;
@@ -27,6 +35,7 @@ namespace Zen {
         Vec2 camera;
 
         void load_room(Point cell, bool is_reload = false);
+        void reload_room();
 
         void startup();
         void shutdown();
@@ -34,10 +43,24 @@ namespace Zen {
         void render();
 
     private:
+        // slack so frame times that are exact multiples of the step
+        // don't alternate between too few and too many steps
+        static constexpr float step_tolerance = 0.0001f;
+
+        void step(float delta);
+
         // debug flags
         bool m_draw_colliders;
         bool m_frame_by_frame;
 
+        // fixed timestep
+        float m_accumulator = 0;
+        float m_interpolation = 1.0f;
+        Vec2 m_last_camera;
+
+        // the room the world's snapshot was taken in
+        Point m_snapshot_room;
+
         // room transition
         bool m_transition = false;
         float m_next_ease;
@@ -0,0 +1,274 @@
+#include <blah.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "game.h"
+#include "content.h"
+#include "replay.h"
+#include "profiler.h"
+#include "boxes.h"
+#include "components/mover.h"
+
+using namespace Blah;
+using namespace Zen;
+
+// Runs the game without a window, stepping a fixed number of frames per
+// room and printing how long they took. Nothing is drawn, but the world's
+// render pass still runs so that sorting and batching show up in the numbers.
+//
+//   blah_sandbox_headless [--frames N] [--threads N] [--room X Y] [--reloads N]
+//   blah_sandbox_headless [--threads N] --replay FILE
+//
+// without --room every room in the map is run in turn. with --replay a
+// recorded play-through is run from the start, one fixed step per frame.
+// --reloads N also times reloading each room N times, by clearing the
+// world and loading the room again and by restoring it from a snapshot.
+// --threads N lets component types that declare their access update
+// across N threads. the game itself always updates on one.
+// --profile FILE also collects per zone timings and writes a chrome trace.
+// --boxes scalar|sse2|avx2 picks the collider bounds test instead of the
+// best one the CPU supports
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    const float frame_delta = 1.0f / 60.0f;
+    const int max_room_columns = 64;
+    const int max_room_rows = 16;
+
+    struct Options {
+        int frames = 600;
+        int threads = 0;
+        int reloads = 0;
+        bool single_room = false;
+        Point room;
+        const char* replay = nullptr;
+        const char* profile = nullptr;
+        const char* boxes = nullptr;
+    };
+
+    struct Stats {
+        double total = 0;
+        double worst = 0;
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                options.frames = std::max(1, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--reloads") == 0 && i + 1 < argc) {
+                options.reloads = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                options.threads = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--room") == 0 && i + 2 < argc) {
+                options.single_room = true;
+                options.room.x = atoi(argv[++i]);
+                options.room.y = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+                options.replay = argv[++i];
+            } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                options.profile = argv[++i];
+            } else if (strcmp(argv[i], "--boxes") == 0 && i + 1 < argc) {
+                options.boxes = argv[++i];
+            } else {
+                printf("unknown argument '%s'\n", argv[i]);
+            }
+        }
+        return options;
+    }
+
+    Stats measure(Vector<double>& times) {
+        Stats stats;
+        if (times.size() <= 0) {
+            return stats;
+        }
+
+        for (auto& it : times) {
+            stats.total += it;
+            stats.worst = std::max(stats.worst, it);
+        }
+
+        std::sort(times.begin(), times.end());
+        auto at = [&](double p) { return times[std::min((int) times.size() - 1, (int) (p * times.size()))]; };
+        stats.p50 = at(0.50);
+        stats.p95 = at(0.95);
+        stats.p99 = at(0.99);
+        return stats;
+    }
+
+    void print(const char* label, int entities, Vector<double>& times) {
+        auto stats = measure(times);
+        printf("%-10s %6d entities  %8.1f fps  avg %7.3f ms  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f\n",
+               label, entities,
+               stats.total > 0 ? times.size() / stats.total : 0.0,
+               stats.total * 1000.0 / std::max((int) times.size(), 1),
+               stats.p50 * 1000.0, stats.p95 * 1000.0, stats.p99 * 1000.0, stats.worst * 1000.0);
+    }
+
+    void print_ground_stats(int frames) {
+        auto stats = Mover::ground_stats();
+        printf("ground contact: %.1f collider checks per frame, %.1f saved by the cache\n",
+               stats.checks / (double) std::max(frames, 1), stats.saved / (double) std::max(frames, 1));
+    }
+
+    int count_entities(World& world) {
+        int count = 0;
+        for (auto it = world.first_entity(); it; it = it->next()) {
+            count++;
+        }
+        return count;
+    }
+
+    double run_frame(Game& game, float delta) {
+        auto start = Clock::now();
+
+        Time::delta = delta;
+        game.update();
+        game.world.render(game.batch);
+        game.batch.clear();
+
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void run_replay(Game& game, Vector<double>& all) {
+        while (!Replay::finished()) {
+            all.push_back(run_frame(game, Game::fixed_step_duration));
+        }
+        print("replay", count_entities(game.world), all);
+        print_ground_stats(all.size());
+    }
+
+    // the two ways Game::reload_room can bring a room back. the snapshot
+    // is taken from a fresh load, so both end up with the same entities
+    void run_reloads(Game& game, Point room, int reloads) {
+        game.world.clear();
+        game.load_room(room, true);
+        game.world.snapshot();
+
+        Vector<double> rebuild;
+        Vector<double> restore;
+        for (int i = 0; i < reloads; i++) {
+            auto start = Clock::now();
+            game.world.clear();
+            game.load_room(room, true);
+            rebuild.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+
+            start = Clock::now();
+            game.world.restore();
+            restore.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+
+        int entities = count_entities(game.world);
+        game.world.discard_snapshot();
+
+        print(" rebuild", entities, rebuild);
+        print(" restore", entities, restore);
+    }
+
+    void run_room(Game& game, Point room, int frames, int reloads, Vector<double>& all) {
+        game.world.clear();
+        game.load_room(room);
+        game.camera = Vec2(room.x * Game::width, room.y * Game::height);
+
+        Vector<double> times;
+        for (int i = 0; i < frames; i++) {
+            times.push_back(run_frame(game, frame_delta));
+        }
+
+        for (auto& it : times) {
+            all.push_back(it);
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "room %d,%d", room.x, room.y);
+        print(label, count_entities(game.world), times);
+
+        if (reloads > 0) {
+            run_reloads(game, room, reloads);
+        }
+    }
+
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    auto options = parse(argc, argv);
+
+    // the replay has to be loaded before startup builds the first room
+    if (options.replay && !Replay::play(options.replay)) {
+        return 1;
+    }
+
+    if (options.profile) {
+        Profiler::start(options.profile);
+    }
+
+    Game game;
+    game.headless = true;
+    game.startup();
+    if (options.threads > 0) {
+        game.world.set_threads(options.threads);
+    }
+
+    if (options.boxes) {
+        bool found = false;
+        for (auto kernel : { Boxes::Kernel::scalar, Boxes::Kernel::sse2, Boxes::Kernel::avx2 }) {
+            if (strcmp(options.boxes, Boxes::name(kernel)) == 0) {
+                found = true;
+                if (!Boxes::use(kernel)) {
+                    printf("%s isn't supported here, using %s\n", options.boxes, Boxes::name(Boxes::kernel()));
+                }
+            }
+        }
+        if (!found) {
+            printf("unknown bounds test '%s'\n", options.boxes);
+        }
+    }
+
+    Vector<double> all;
+    if (options.replay) {
+        printf("replaying %d steps on %d threads, %s bounds test\n",
+            Replay::step_count(), game.world.threads(), Boxes::name(Boxes::kernel()));
+        run_replay(game, all);
+        game.shutdown();
+        return 0;
+    }
+
+    printf("running %d frames per room on %d threads, %s bounds test\n",
+        options.frames, game.world.threads(), Boxes::name(Boxes::kernel()));
+
+    if (options.single_room) {
+        if (!Content::find_room(options.room)) {
+            printf("room %d,%d doesn't exist\n", options.room.x, options.room.y);
+            game.shutdown();
+            return 1;
+        }
+        run_room(game, options.room, options.frames, options.reloads, all);
+    } else {
+        // the map has gaps in it, so look over a generous area
+        for (int x = 0; x < max_room_columns; x++) {
+            for (int y = 0; y < max_room_rows; y++) {
+                if (Content::find_room(Point(x, y))) {
+                    run_room(game, Point(x, y), options.frames, options.reloads, all);
+                }
+            }
+        }
+    }
+
+    print("total", 0, all);
+    print_ground_stats(all.size());
+    game.world.log_stats();
+
+    game.shutdown();
+    return 0;
+}
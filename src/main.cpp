@@ -1,6 +1,10 @@
 #include <blah.h>
 
 #include "game.h"
+#include "replay.h"
+#include "profiler.h"
+
+#include <cstring>
 
 using namespace Blah;
 using namespace Zen;
@@ -32,7 +36,19 @@ namespace {
 
 // ----------------------------------------------------------------------------
 
-int main() {
+int main(int argc, char** argv) {
+    // --record <file> saves the play-through's input, --replay <file> plays it back,
+    // --profile <file> times each frame and writes a chrome trace on exit
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0) {
+            Replay::record(argv[++i]);
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            Replay::play(argv[++i]);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            Profiler::start(argv[++i]);
+        }
+    }
+
     Config config;
     config.name = "Blah Sandbox";
     config.width = window_width;
@@ -0,0 +1,230 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    struct Zone {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        int thread;
+    };
+
+    struct Frame {
+        uint64_t start = 0;
+        uint64_t end = 0;
+        std::atomic<int> count { 0 };
+        Zone zones[Profiler::max_zones_per_frame];
+    };
+
+    // frames are big, so the ring is only allocated once profiling starts
+    std::unique_ptr<Frame[]> frames;
+    int frame_index = 0;
+    int frame_total = 0;
+    bool frame_open = false;
+    std::atomic<int> dropped { 0 };
+    std::string trace_file;
+
+    // small stable ids for the trace's thread lanes
+    std::atomic<int> next_thread { 0 };
+    thread_local int thread_id = next_thread++;
+
+    const auto epoch = std::chrono::steady_clock::now();
+
+    // frames that have finished, oldest first
+    int closed_count() {
+        return std::min(frame_total, Profiler::max_frames);
+    }
+
+    Frame& closed_frame(int i) {
+        int oldest = frame_total > Profiler::max_frames ? frame_index : 0;
+        return frames[(oldest + i) % Profiler::max_frames];
+    }
+
+    void close_frame() {
+        if (frame_open) {
+            frames[frame_index].end = Profiler::now();
+            frame_index = (frame_index + 1) % Profiler::max_frames;
+            frame_total++;
+            frame_open = false;
+        }
+    }
+
+    double percentile(Vector<double>& values, double p) {
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, (int) (p * values.size()))];
+    }
+
+}
+
+void Profiler::start(const char* trace_path) {
+    if (!frames) {
+        frames = std::make_unique<Frame[]>(max_frames);
+    }
+
+    trace_file = trace_path ? trace_path : "";
+    frame_index = 0;
+    frame_total = 0;
+    frame_open = false;
+    dropped = 0;
+    m_enabled = true;
+}
+
+void Profiler::stop() {
+    if (!m_enabled) {
+        return;
+    }
+
+    close_frame();
+    m_enabled = false;
+
+    print_summary();
+    if (!trace_file.empty()) {
+        export_trace(trace_file.c_str());
+    }
+}
+
+void Profiler::frame() {
+    if (!m_enabled) {
+        return;
+    }
+
+    close_frame();
+
+    auto& next = frames[frame_index];
+    next.start = now();
+    next.count = 0;
+    frame_open = true;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    if (!frame_open) {
+        return;
+    }
+
+    auto& current = frames[frame_index];
+    int slot = current.count.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= max_zones_per_frame) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& zone = current.zones[slot];
+    zone.name = name;
+    zone.start = start;
+    zone.end = end;
+    zone.thread = thread_id;
+}
+
+uint64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+bool Profiler::export_trace(const char* path) {
+    FILE* stream = fopen(path, "w");
+    if (!stream) {
+        Log::warn("Unable to write profiler trace %s", path);
+        return false;
+    }
+
+    // complete ("X") events, in microseconds
+    fprintf(stream, "{\"traceEvents\":[\n");
+    bool first = true;
+    auto event = [&](const char* name, uint64_t start, uint64_t end, int thread) {
+        fprintf(stream, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", name, thread, start / 1000.0, (end - start) / 1000.0);
+        first = false;
+    };
+
+    for (int i = 0; i < closed_count(); i++) {
+        auto& frame = closed_frame(i);
+        event("frame", frame.start, frame.end, 0);
+
+        int count = std::min(frame.count.load(), max_zones_per_frame);
+        for (int j = 0; j < count; j++) {
+            auto& zone = frame.zones[j];
+            event(zone.name, zone.start, zone.end, zone.thread);
+        }
+    }
+
+    fprintf(stream, "\n]}\n");
+    fclose(stream);
+
+    Log::print("Profiler trace written to %s", path);
+    return true;
+}
+
+void Profiler::print_summary() {
+    int count = closed_count();
+    if (count <= 0) {
+        return;
+    }
+
+    // zones with the same name are totalled per frame, so a type that
+    // updates across several threads reports its combined time
+    Vector<const char*> names;
+    for (int i = 0; i < count; i++) {
+        auto& frame = closed_frame(i);
+        int zones = std::min(frame.count.load(), max_zones_per_frame);
+        for (int j = 0; j < zones; j++) {
+            auto name = frame.zones[j].name;
+            bool found = false;
+            for (auto& it : names) {
+                if (strcmp(it, name) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                names.push_back(name);
+            }
+        }
+    }
+
+    Log::print("Profiler: %i frames, times in ms (p50 / p95 / p99)", count);
+
+    Vector<double> times;
+    for (int i = 0; i < count; i++) {
+        auto& frame = closed_frame(i);
+        times.push_back((frame.end - frame.start) / 1000000.0);
+    }
+    Log::print("  %-28s %8.3f %8.3f %8.3f", "frame",
+               percentile(times, 0.50), percentile(times, 0.95), percentile(times, 0.99));
+
+    for (auto& name : names) {
+        // only frames the zone ran in count, so rare zones aren't all zeroes
+        times.clear();
+        for (int i = 0; i < count; i++) {
+            auto& frame = closed_frame(i);
+            int zones = std::min(frame.count.load(), max_zones_per_frame);
+            uint64_t total = 0;
+            bool ran = false;
+            for (int j = 0; j < zones; j++) {
+                if (strcmp(frame.zones[j].name, name) == 0) {
+                    total += frame.zones[j].end - frame.zones[j].start;
+                    ran = true;
+                }
+            }
+            if (ran) {
+                times.push_back(total / 1000000.0);
+            }
+        }
+
+        Log::print("  %-28s %8.3f %8.3f %8.3f  (%i frames)", name,
+                   percentile(times, 0.50), percentile(times, 0.95), percentile(times, 0.99), times.size());
+    }
+
+    if (dropped > 0) {
+        Log::warn("Profiler dropped %i zones, frames are limited to %i", dropped.load(), max_zones_per_frame);
+    }
+}
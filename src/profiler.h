@@ -0,0 +1,81 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+
+using namespace Blah;
+
+// set ZEN_PROFILER to 0 to compile every zone out entirely. otherwise zones
+// are always built in and only cost a flag check while profiling is off
+#ifndef ZEN_PROFILER
+#define ZEN_PROFILER 1
+#endif
+
+#if ZEN_PROFILER
+#define ZEN_PROFILE_JOIN2(a, b) a##b
+#define ZEN_PROFILE_JOIN(a, b) ZEN_PROFILE_JOIN2(a, b)
+#define ZEN_PROFILE(name) Zen::ProfileZone ZEN_PROFILE_JOIN(profile_zone_, __LINE__)(name)
+#else
+#define ZEN_PROFILE(name) do {} while (false)
+#endif
+
+namespace Zen {
+
+    // Collects timed zones into a ring buffer of recent frames. Zones can be
+    // recorded from any thread, frames are only started from the main thread.
+    class Profiler {
+    public:
+        static constexpr int max_frames = 300;
+        static constexpr int max_zones_per_frame = 512;
+
+        static bool enabled() { return m_enabled; }
+
+        // starts collecting frames. the trace is written out by stop(),
+        // if a path was given
+        static void start(const char* trace_path = nullptr);
+
+        // ends the last frame, logs the summary and exports the trace
+        static void stop();
+
+        // ends the current frame and starts the next one
+        static void frame();
+
+        // records a zone that ran over [start, end), in Profiler::now() time
+        static void record(const char* name, uint64_t start, uint64_t end);
+
+        // nanoseconds since the profiler was first used
+        static uint64_t now();
+
+        // writes the buffered frames as a trace viewable in chrome://tracing
+        static bool export_trace(const char* path);
+
+        // logs per zone p50/p95/p99 frame times over the buffered frames
+        static void print_summary();
+
+    private:
+        static inline bool m_enabled = false;
+    };
+
+    class ProfileZone {
+    public:
+        explicit ProfileZone(const char* name) {
+            if (Profiler::enabled()) {
+                m_name = name;
+                m_start = Profiler::now();
+            }
+        }
+
+        ~ProfileZone() {
+            if (m_name) {
+                Profiler::record(m_name, m_start, Profiler::now());
+            }
+        }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+
+    private:
+        const char* m_name = nullptr;
+        uint64_t m_start = 0;
+    };
+
+}
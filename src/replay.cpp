@@ -0,0 +1,177 @@
+#include "replay.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    // file layout: magic, version, seed, step count, then one byte per step
+    constexpr char magic[4] = { 'Z', 'R', 'E', 'P' };
+    constexpr uint32_t version = 1;
+
+    // packed frame bits
+    constexpr uint8_t move_left = 1 << 0;
+    constexpr uint8_t move_right = 1 << 1;
+    constexpr uint8_t jump_pressed = 1 << 2;
+    constexpr uint8_t jump_down = 1 << 3;
+    constexpr uint8_t attack_pressed = 1 << 4;
+
+    Replay::Mode current_mode = Replay::Mode::Off;
+    FilePath file;
+    uint32_t seed = 0;
+    Vector<uint8_t> frames;
+    int current_step = -1;
+
+    uint8_t pack(const InputFrame& frame) {
+        uint8_t bits = 0;
+        if (frame.move_x < 0) bits |= move_left;
+        if (frame.move_x > 0) bits |= move_right;
+        if (frame.jump_pressed) bits |= jump_pressed;
+        if (frame.jump_down) bits |= jump_down;
+        if (frame.attack_pressed) bits |= attack_pressed;
+        return bits;
+    }
+
+    InputFrame unpack(uint8_t bits) {
+        InputFrame frame;
+        frame.move_x = ((bits & move_right) ? 1 : 0) - ((bits & move_left) ? 1 : 0);
+        frame.jump_pressed = (bits & jump_pressed) != 0;
+        frame.jump_down = (bits & jump_down) != 0;
+        frame.attack_pressed = (bits & attack_pressed) != 0;
+        return frame;
+    }
+
+    void write_u32(FILE* stream, uint32_t value) {
+        uint8_t bytes[4] = { (uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+        fwrite(bytes, 1, 4, stream);
+    }
+
+    bool read_u32(FILE* stream, uint32_t& value) {
+        uint8_t bytes[4];
+        if (fread(bytes, 1, 4, stream) != 4) {
+            return false;
+        }
+        value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+        return true;
+    }
+
+}
+
+void Replay::record(const FilePath& path) {
+    current_mode = Mode::Record;
+    file = path;
+    seed = (uint32_t) time(nullptr);
+    frames.clear();
+    current_step = -1;
+
+    srand(seed);
+    Log::print("Recording input to %s (seed %u)", file.cstr(), seed);
+}
+
+bool Replay::play(const FilePath& path) {
+    current_mode = Mode::Off;
+    frames.clear();
+    current_step = -1;
+
+    FILE* stream = fopen(path.cstr(), "rb");
+    if (!stream) {
+        Log::warn("Unable to open replay %s", path.cstr());
+        return false;
+    }
+
+    char header[4];
+    uint32_t file_version = 0;
+    uint32_t count = 0;
+    bool valid = fread(header, 1, 4, stream) == 4
+            && memcmp(header, magic, 4) == 0
+            && read_u32(stream, file_version) && file_version == version
+            && read_u32(stream, seed)
+            && read_u32(stream, count);
+
+    if (valid) {
+        frames.expand((int) count);
+        valid = fread(frames.data(), 1, count, stream) == count;
+    }
+    fclose(stream);
+
+    if (!valid) {
+        Log::warn("Replay %s is not a valid recording", path.cstr());
+        frames.clear();
+        return false;
+    }
+
+    current_mode = Mode::Playback;
+    file = path;
+    srand(seed);
+    Log::print("Playing back %s (%i steps, seed %u)", file.cstr(), frames.size(), seed);
+    return true;
+}
+
+void Replay::stop() {
+    if (current_mode == Mode::Record) {
+        FILE* stream = fopen(file.cstr(), "wb");
+        if (stream) {
+            fwrite(magic, 1, 4, stream);
+            write_u32(stream, version);
+            write_u32(stream, seed);
+            write_u32(stream, (uint32_t) frames.size());
+            fwrite(frames.data(), 1, frames.size(), stream);
+            fclose(stream);
+            Log::print("Saved %i steps of input to %s", frames.size(), file.cstr());
+        } else {
+            Log::warn("Unable to write replay %s", file.cstr());
+        }
+    }
+
+    current_mode = Mode::Off;
+    frames.clear();
+    current_step = -1;
+}
+
+Replay::Mode Replay::mode() {
+    return current_mode;
+}
+
+bool Replay::finished() {
+    return current_mode == Mode::Playback && current_step >= frames.size();
+}
+
+int Replay::step_count() {
+    return frames.size();
+}
+
+void Replay::step() {
+    if (current_mode == Mode::Off) {
+        return;
+    }
+
+    current_step++;
+
+    // steps where nobody reads input still take up a frame, so that
+    // playback stays lined up with the steps it was recorded on
+    if (current_mode == Mode::Record) {
+        frames.push_back(0);
+    }
+}
+
+InputFrame Replay::input(const InputFrame& live) {
+    if (current_step < 0 || current_step >= frames.size()) {
+        return live;
+    }
+
+    if (current_mode == Mode::Record) {
+        frames[current_step] = pack(live);
+        return live;
+    }
+
+    if (current_mode == Mode::Playback) {
+        return unpack(frames[current_step]);
+    }
+
+    return live;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+
+using namespace Blah;
+
+namespace Zen {
+
+    // The player's input for a single fixed step
+    struct InputFrame {
+        int move_x = 0;
+        bool jump_pressed = false;
+        bool jump_down = false;
+        bool attack_pressed = false;
+    };
+
+    // Records the player's input once per fixed step, along with the random
+    // seed rooms are built with, so that a play-through can be fed back into
+    // the game later and run exactly the same way. Files are one byte per step.
+    class Replay {
+    public:
+        enum class Mode { Off, Record, Playback };
+
+        // both of these seed the random number generator, so they need to be
+        // called before the first room is built
+        static void record(const FilePath& path);
+        static bool play(const FilePath& path);
+
+        // writes out the recording, if there is one
+        static void stop();
+
+        static Mode mode();
+        static bool finished();
+        static int step_count();
+
+        // called at the start of every fixed step
+        static void step();
+
+        // records the live input while recording, or swaps in the
+        // recorded input for the current step when playing back
+        static InputFrame input(const InputFrame& live);
+    };
+
+}
@@ -0,0 +1,184 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+using namespace Zen;
+
+namespace {
+
+    // a slice's range is packed into one word so that the owner popping
+    // from the front and thieves stealing from the back can both CAS it
+    uint64_t pack(uint32_t begin, uint32_t end) {
+        return ((uint64_t) begin << 32) | end;
+    }
+
+    uint32_t range_begin(uint64_t range) {
+        return (uint32_t) (range >> 32);
+    }
+
+    uint32_t range_end(uint64_t range) {
+        return (uint32_t) range;
+    }
+
+}
+
+Scheduler::Scheduler() = default;
+
+Scheduler::~Scheduler() {
+    stop_workers();
+}
+
+int Scheduler::threads() const {
+    return m_thread_count;
+}
+
+void Scheduler::set_threads(int count) {
+    count = std::clamp(count, 1, max_threads);
+    if (count == m_thread_count) {
+        return;
+    }
+
+    stop_workers();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+
+    // thread 0 is always whoever calls run()
+    m_thread_count = count;
+    for (int i = 1; i < count; i++) {
+        m_workers[i] = std::make_unique<std::thread>(&Scheduler::worker_main, this, i);
+    }
+}
+
+void Scheduler::stop_workers() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& it : m_workers) {
+        if (it) {
+            it->join();
+            it.reset();
+        }
+    }
+}
+
+void Scheduler::run_jobs(int count, int batch_size, Job job, void* data) {
+    if (count <= 0) {
+        return;
+    }
+
+    // not worth waking anyone up
+    if (m_thread_count <= 1 || count <= batch_size) {
+        job(data, 0, count);
+        return;
+    }
+
+    // give every thread an even slice to start with
+    for (int i = 0; i < m_thread_count; i++) {
+        m_slices[i].range.store(pack(
+                (uint32_t) ((int64_t) count * i / m_thread_count),
+                (uint32_t) ((int64_t) count * (i + 1) / m_thread_count)), std::memory_order_relaxed);
+    }
+
+    m_job = job;
+    m_data = data;
+    m_batch_size = std::max(batch_size, 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    work(0);
+
+    // once the slices are empty, the only work left is batches
+    // other threads already popped, so wait for them to finish up
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_running = false;
+    m_idle.wait(lock, [this] { return m_busy == 0; });
+}
+
+void Scheduler::work(int index) {
+    int begin, end;
+    do {
+        while (pop(index, begin, end)) {
+            m_job(m_data, begin, end);
+        }
+    } while (steal(index));
+}
+
+bool Scheduler::pop(int index, int& begin, int& end) {
+    auto& range = m_slices[index].range;
+    auto current = range.load(std::memory_order_acquire);
+
+    while (true) {
+        auto b = range_begin(current);
+        auto e = range_end(current);
+        if (b >= e) {
+            return false;
+        }
+
+        auto next = std::min(b + (uint32_t) m_batch_size, e);
+        if (range.compare_exchange_weak(current, pack(next, e), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            begin = (int) b;
+            end = (int) next;
+            return true;
+        }
+    }
+}
+
+bool Scheduler::steal(int index) {
+    for (int i = 1; i < m_thread_count; i++) {
+        auto& victim = m_slices[(index + i) % m_thread_count].range;
+        auto current = victim.load(std::memory_order_acquire);
+
+        while (true) {
+            auto b = range_begin(current);
+            auto e = range_end(current);
+            if (b >= e) {
+                break;
+            }
+
+            // take the back half, or the last job if that's all there is
+            auto mid = b + (e - b) / 2;
+            if (victim.compare_exchange_weak(current, pack(b, mid), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                m_slices[index].range.store(pack(mid, e), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void Scheduler::worker_main(int index) {
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || (m_running && m_generation != seen); });
+            if (m_stopping) {
+                return;
+            }
+
+            seen = m_generation;
+            m_busy++;
+        }
+
+        work(index);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy--;
+        }
+        m_idle.notify_one();
+    }
+}
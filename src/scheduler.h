@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <cinttypes>
+#include <memory>
+#include <type_traits>
+
+namespace Zen {
+
+    // A small work-stealing thread pool for splitting a range of jobs
+    // across threads. Each thread owns a slice of the range and works
+    // through it from the front, and once it runs dry it steals the back
+    // half of whichever slice still has work left.
+    class Scheduler {
+    public:
+        static constexpr int max_threads = 32;
+
+        Scheduler();
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        ~Scheduler();
+
+        // total number of threads used by run(), including the caller
+        int threads() const;
+        void set_threads(int count);
+
+        // calls fn(begin, end) over [0, count) in batches of at most batch_size,
+        // returning once every batch is done. the calling thread helps out
+        template<class F> void run(int count, int batch_size, F&& fn);
+
+    private:
+        using Job = void (*)(void* data, int begin, int end);
+
+        struct alignas(64) Slice {
+            std::atomic<uint64_t> range { 0 };
+        };
+
+        void run_jobs(int count, int batch_size, Job job, void* data);
+        void work(int index);
+        bool pop(int index, int& begin, int& end);
+        bool steal(int index);
+        void worker_main(int index);
+        void stop_workers();
+
+        int m_thread_count = 1;
+        std::unique_ptr<std::thread> m_workers[max_threads];
+        Slice m_slices[max_threads];
+
+        // the current run
+        Job m_job = nullptr;
+        void* m_data = nullptr;
+        int m_batch_size = 1;
+        std::atomic<int> m_remaining { 0 };
+
+        // worker signalling
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        uint64_t m_generation = 0;
+        bool m_running = false;
+        bool m_stopping = false;
+        int m_busy = 0;
+    };
+
+    template<class F> void Scheduler::run(int count, int batch_size, F&& fn) {
+        using Fn = std::remove_reference_t<F>;
+        run_jobs(count, batch_size, [](void* data, int begin, int end) { (*(Fn*) data)(begin, end); }, (void*) &fn);
+    }
+
+}
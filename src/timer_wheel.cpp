@@ -0,0 +1,170 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Blah;
+using namespace Zen;
+
+namespace {
+
+    // keeps float rounding in step lengths and durations from landing a tick late
+    constexpr double tick_epsilon = 1e-4;
+
+}
+
+TimerWheel::TimerWheel() {
+    for (auto& it : m_heads) {
+        it = -1;
+    }
+}
+
+int TimerWheel::schedule(Component* owner, Fire fire, uint64_t due) {
+    int handle;
+    if (m_free >= 0) {
+        handle = m_free;
+        m_free = m_nodes[handle].next;
+    } else {
+        handle = m_nodes.size();
+        m_nodes.expand();
+    }
+
+    auto& node = m_nodes[handle];
+    node.owner = owner;
+    node.fire = fire;
+    node.due = (due > m_tick ? due : m_tick + 1);
+    insert(handle);
+
+    m_count++;
+    return handle;
+}
+
+void TimerWheel::cancel(int handle) {
+    if (handle < 0 || handle >= m_nodes.size() || m_nodes[handle].slot < 0) {
+        return;
+    }
+
+    unlink(handle);
+    m_nodes[handle].owner = nullptr;
+    m_nodes[handle].next = m_free;
+    m_free = handle;
+    m_count--;
+}
+
+double TimerWheel::tick_duration() const {
+    return m_tick_duration;
+}
+
+void TimerWheel::set_tick_duration(double seconds) {
+    BLAH_ASSERT(m_count == 0, "Cannot change the tick duration while timers are scheduled");
+    BLAH_ASSERT(seconds > 0, "Tick duration must be positive");
+
+    // keep the current tick where it is, so ticks already handed out stay in the past
+    m_tick_duration = seconds;
+    m_time = m_tick * seconds;
+}
+
+uint64_t TimerWheel::due_after(float seconds) const {
+    // counted from the current tick, so rounding in the running time can't creep in
+    auto ticks = (uint64_t) std::max(1.0, std::ceil(seconds / m_tick_duration - tick_epsilon));
+    return m_tick + ticks;
+}
+
+void TimerWheel::advance(float seconds) {
+    m_time += seconds;
+    auto target = (uint64_t) std::floor(m_time / m_tick_duration + tick_epsilon);
+
+    while (m_tick < target) {
+        m_tick++;
+
+        // bring down the next block of each level whose lower levels just wrapped
+        for (int level = 1; level < levels; level++) {
+            if ((m_tick & (((uint64_t) 1 << (slot_bits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        // fire this tick's slot. firing can schedule and cancel anything,
+        // so take entries off the front one at a time
+        auto& head = m_heads[m_tick & (slots - 1)];
+        while (head >= 0) {
+            int handle = head;
+            auto owner = m_nodes[handle].owner;
+            auto fire = m_nodes[handle].fire;
+            cancel(handle);
+            fire(owner);
+        }
+    }
+}
+
+uint64_t TimerWheel::tick() const {
+    return m_tick;
+}
+
+double TimerWheel::time() const {
+    return m_time;
+}
+
+void TimerWheel::reset(uint64_t tick, double time) {
+    BLAH_ASSERT(m_count == 0, "Cannot reset the timer wheel while timers are scheduled");
+    m_tick = tick;
+    m_time = time;
+}
+
+int TimerWheel::count() const {
+    return m_count;
+}
+
+void TimerWheel::insert(int handle) {
+    auto& node = m_nodes[handle];
+    uint64_t delta = node.due - m_tick;
+
+    // the lowest level whose span reaches the due tick. anything further out
+    // than the top level can reach waits in its last slot and cascades again
+    int level = 0;
+    while (level < levels - 1 && delta >= ((uint64_t) 1 << (slot_bits * (level + 1)))) {
+        level++;
+    }
+
+    uint64_t index;
+    if (delta >= ((uint64_t) 1 << (slot_bits * levels))) {
+        index = (m_tick >> (slot_bits * level)) + slots - 1;
+    } else {
+        index = node.due >> (slot_bits * level);
+    }
+
+    node.slot = level * slots + (int) (index & (slots - 1));
+    node.prev = -1;
+    node.next = m_heads[node.slot];
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = handle;
+    }
+    m_heads[node.slot] = handle;
+}
+
+void TimerWheel::unlink(int handle) {
+    auto& node = m_nodes[handle];
+    if (node.prev >= 0) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_heads[node.slot] = node.next;
+    }
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.slot = -1;
+    node.prev = node.next = -1;
+}
+
+void TimerWheel::cascade(int level) {
+    int slot = level * slots + (int) ((m_tick >> (slot_bits * level)) & (slots - 1));
+
+    int handle = m_heads[slot];
+    m_heads[slot] = -1;
+    while (handle >= 0) {
+        int next = m_nodes[handle].next;
+        insert(handle);
+        handle = next;
+    }
+}
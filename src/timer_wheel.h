@@ -0,0 +1,69 @@
+#pragma once
+#include <blah.h>
+#include <cinttypes>
+
+namespace Zen {
+
+    class Component;
+
+    // A hierarchical timing wheel. Scheduled entries sit in a slot until
+    // their tick comes around, so waiting costs nothing per update, and the
+    // work done each tick scales with the entries that fire (plus the odd
+    // cascade of a far off slot down to a nearer level).
+    class TimerWheel {
+    public:
+        using Fire = void (*)(Component* owner);
+
+        static constexpr int slot_bits = 6;
+        static constexpr int slots = 1 << slot_bits;
+        static constexpr int levels = 4;
+
+        TimerWheel();
+
+        // schedules fire(owner) for the given tick, returning a handle to cancel it with
+        int schedule(Component* owner, Fire fire, uint64_t due);
+        void cancel(int handle);
+
+        // the wheel counts time in ticks, which should match the step the
+        // World is updated with (120 Hz until told otherwise).
+        // only allowed while empty
+        double tick_duration() const;
+        void set_tick_duration(double seconds);
+
+        // the tick an entry scheduled now would need to wait for the given delay
+        uint64_t due_after(float seconds) const;
+
+        // moves time forward, firing everything that comes due in order
+        void advance(float seconds);
+
+        // the current time, and how to put it back. only allowed while empty
+        uint64_t tick() const;
+        double time() const;
+        void reset(uint64_t tick, double time);
+
+        int count() const;
+
+    private:
+        struct Node {
+            Component* owner;
+            Fire fire;
+            uint64_t due;
+            int slot;
+            int prev;
+            int next;
+        };
+
+        void insert(int handle);
+        void unlink(int handle);
+        void cascade(int level);
+
+        Blah::Vector<Node> m_nodes;
+        int m_free = -1;
+        int m_count = 0;
+        int m_heads[levels * slots];
+        uint64_t m_tick = 0;
+        double m_time = 0;
+        double m_tick_duration = 1.0 / 120.0;
+    };
+
+}
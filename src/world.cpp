@@ -1,6 +1,9 @@
 #include "world.h"
+#include "profiler.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cmath>
 
 using namespace Blah;
 using namespace Zen;
@@ -47,11 +50,32 @@ void Component::destroy() {
     }
 }
 
+bool Component::is_destroyed() const {
+    return m_destroyed;
+}
+
+void Component::declare(Access&) {}
+
 void Component::awake() {}
 void Component::update() {}
 void Component::render(Batch& batch) {}
 void Component::destroyed() {}
 
+Vec2 Entity::render_position() const {
+    auto diff = position - m_last_position;
+    auto t = (m_world ? m_world->interpolation() : 1.0f);
+    if (t >= 1.0f
+     || Calc::abs(diff.x) > World::max_interpolation_distance
+     || Calc::abs(diff.y) > World::max_interpolation_distance) {
+        return Vec2(position.x, position.y);
+    }
+
+    // keep to whole pixels
+    return Vec2(
+        std::floor(m_last_position.x + diff.x * t + 0.5f),
+        std::floor(m_last_position.y + diff.y * t + 0.5f));
+}
+
 World* Entity::world() {
     return m_world;
 }
@@ -88,49 +112,109 @@ void Entity::destroy() {
     m_world->destroy_entity(this);
 }
 
+bool Entity::add_slot(Component* component) {
+    // only the first component of each type gets a slot, matching get<T>()
+    auto type = component->m_type;
+    if (m_types.has(type)) {
+        return false;
+    }
+
+    // slots are kept ordered by type, so a type's slot index is its rank
+    int index = m_types.rank(type);
+    m_types.set(type);
+    m_slots.push_back(component);
+    for (int i = m_slots.size() - 1; i > index; i--) {
+        m_slots[i] = m_slots[i - 1];
+    }
+    m_slots[index] = component;
+    return true;
+}
+
+bool Entity::remove_slot(Component* component) {
+    auto type = component->m_type;
+    int index = m_types.rank(type);
+    if (!m_types.has(type) || m_slots[index] != component) {
+        return false;
+    }
+
+    // hand the slot to the next remaining component of the same type
+    for (auto& it : m_components) {
+        if (it->m_type == type && it != component) {
+            m_slots[index] = it;
+            return false;
+        }
+    }
+
+    // that was the last one
+    m_types.reset(type);
+    m_slots.erase(index);
+    return true;
+}
+
+int Entity::query_index(int query) const {
+    return (query < m_query_indices.size() ? m_query_indices[query] : -1);
+}
+
+void Entity::set_query_index(int query, int index) {
+    while (m_query_indices.size() <= query) {
+        m_query_indices.push_back(-1);
+    }
+    m_query_indices[query] = index;
+}
+
 World::~World() {
     // destroy all the entities
     while (m_alive.first) {
         destroy_entity(m_alive.first);
     }
 
-    // delete component instances
-    for (int i = 0; i < Component::Types::count(); i++) {
-        Component* c = m_components_cache[i].first;
-        while (c) {
-            Component* next = c->m_next;
-            delete c;
-            c = next;
+    discard_snapshot();
+
+    // services go once nothing is left to use them
+    for (auto& it : m_services) {
+        if (it.instance) {
+            it.destroy(it.instance);
         }
     }
 
-    // delete entity instances
-    Entity* e = m_cache.first;
-    while (e) {
-        Entity* next = e->m_next;
-        delete e;
-        e = next;
+    // release the chunks, which deletes every component and entity instance
+    for (auto& it : m_chunks) {
+        it.release(it.instances);
     }
 }
 
 Entity* World::add_entity(Point point) {
-    // create entity instance
-    Entity* instance;
-    if (m_cache.first) {
-        instance = m_cache.first;
-        m_cache.remove(instance);
-        *instance = Entity();
-    } else {
-        instance = new Entity();
+    // grab an entity instance from the cache
+    if (!m_cache.first) {
+        allocate_entities();
     }
 
-    // add to list
-    m_alive.insert(instance);
+    Entity* instance = m_cache.first;
+    m_cache.remove(instance);
+
+    // reset it, keeping the component list's storage around for reuse
+    instance->active = true;
+    instance->visible = true;
+    instance->m_components.clear();
+    instance->m_types = TypeMask();
+    instance->m_slots.clear();
+    instance->m_query_indices.clear();
+    instance->m_destroyed = false;
+    instance->m_checked_components = 0;
+    instance->m_growth_strikes = 0;
 
     // assign
     instance->position = point;
+    instance->m_last_position = point;
     instance->m_world = this;
 
+    // add to list, or wait for the next sync point
+    if (m_deferring) {
+        queue(Command::Op::Spawn, instance, nullptr);
+    } else {
+        m_alive.insert(instance);
+    }
+
     // return new entity
     return instance;
 }
@@ -152,40 +236,30 @@ const Entity* World::last_entity() const {
 }
 
 void World::destroy_entity(Entity* entity) {
-    if (entity && entity->m_world == this) {
-        // destroy components
-        for (int i = entity->m_components.size() - 1; i>= 0; i--) {
-            destroy(entity->m_components[i]);
-        }
+    if (entity && entity->m_world == this && !entity->m_destroyed) {
+        entity->m_destroyed = true;
 
-        // remove ourselves from the list
-        m_alive.remove(entity);
-        m_cache.insert(entity);
-
-        // done
-        entity->m_world = nullptr;
+        if (m_deferring) {
+            // keep its components from updating until it's gone
+            for (auto& it : entity->m_components) {
+                it->m_destroyed = true;
+            }
+            queue(Command::Op::DestroyEntity, entity, nullptr);
+        } else {
+            remove(entity);
+        }
     }
 }
 
 void World::destroy(Component* component) {
-    if (component && component->m_entity && component->m_entity->m_world == this) {
-        auto type = component->m_type;
-
-        // mark destroyed
-        component->destroyed();
-
-        // remove from entity
-        auto& list = component->m_entity->m_components;
-        for (int i = list.size() - 1; i >= 0; i--) {
-            if (list[i] == component) {
-                list.erase(i);
-                break;
-            }
-        }
+    if (component && component->m_entity && component->m_entity->m_world == this && !component->m_destroyed) {
+        component->m_destroyed = true;
 
-        // remove from list
-        m_components_alive[type].remove(component);
-        m_components_cache[type].insert(component);
+        if (m_deferring) {
+            queue(Command::Op::DestroyComponent, component->m_entity, component);
+        } else {
+            remove(component);
+        }
     }
 }
 
@@ -198,49 +272,743 @@ void World::clear() {
     }
 }
 
-void World::update() {
-    for (int i = 0; i < Component::Types::count(); i++) {
-        auto component = m_components_alive[i].first;
-        while (component) {
-            auto next = component->m_next;
-            if (component->active && component->m_entity->active) {
-                component->update();
+void World::snapshot() {
+    BLAH_ASSERT(!m_deferring, "Cannot snapshot the World while it's updating");
+    discard_snapshot();
+
+    // drop any holes so the render order can be saved as is
+    sort_visible();
+
+    // copies go into one buffer, laid out in alive list order
+    size_t size = 0;
+    for (int i = 0; i < m_components_alive.size(); i++) {
+        auto& info = Component::Types::info(i);
+        for (auto c = m_components_alive[i].first; c; c = c->m_next) {
+            size = (size + info.align - 1) / info.align * info.align + info.size;
+        }
+    }
+
+    m_snapshot.data = new unsigned char[size];
+
+    size_t offset = 0;
+    for (int i = 0; i < m_components_alive.size(); i++) {
+        auto& info = Component::Types::info(i);
+        BLAH_ASSERT(info.align <= (int) alignof(std::max_align_t), "Component type is over-aligned");
+
+        for (auto c = m_components_alive[i].first; c; c = c->m_next) {
+            offset = (offset + info.align - 1) / info.align * info.align;
+            info.copy(m_snapshot.data + offset, c);
+
+            Snapshot::ComponentState state;
+            state.instance = c;
+            state.saved = (Component*) (m_snapshot.data + offset);
+            m_snapshot.components.push_back(state);
+
+            offset += info.size;
+        }
+    }
+
+    for (auto e = m_alive.first; e; e = e->m_next) {
+        Snapshot::EntityState state;
+        state.instance = e;
+        state.position = e->position;
+        state.active = e->active;
+        state.visible = e->visible;
+        state.first_component = m_snapshot.entity_components.size();
+        state.component_count = e->m_components.size();
+        m_snapshot.entities.push_back(state);
+
+        for (auto& it : e->m_components) {
+            m_snapshot.entity_components.push_back(it);
+        }
+    }
+
+    m_snapshot.visible = m_visible;
+    m_snapshot.timer_tick = m_timers.tick();
+    m_snapshot.timer_time = m_timers.time();
+    m_snapshot.valid = true;
+}
+
+void World::restore() {
+    BLAH_ASSERT(!m_deferring, "Cannot restore the World while it's updating");
+    BLAH_ASSERT(m_snapshot.valid, "World has no snapshot to restore");
+
+    // everything goes back to the caches, including every saved instance
+    clear();
+    sort_visible();
+
+    // bring the entities back, in their old order
+    for (auto& state : m_snapshot.entities) {
+        auto entity = state.instance;
+        m_cache.remove(entity);
+
+        entity->active = state.active;
+        entity->visible = state.visible;
+        entity->position = state.position;
+        entity->m_last_position = state.position;
+        entity->m_components.clear();
+        entity->m_types = TypeMask();
+        entity->m_slots.clear();
+        entity->m_query_indices.clear();
+        entity->m_destroyed = false;
+        entity->m_checked_components = 0;
+        entity->m_growth_strikes = 0;
+        entity->m_world = this;
+        m_alive.insert(entity);
+    }
+
+    // then the components, in their old update order. assigning the saved
+    // copy also restores the component's type and entity
+    for (auto& state : m_snapshot.components) {
+        auto component = state.instance;
+        m_components_cache[component->m_type].remove(component);
+
+        Component::Types::info(component->m_type).assign(component, state.saved);
+        component->m_destroyed = false;
+        component->m_visible_index = -1;
+        m_components_alive[component->m_type].insert(component);
+    }
+
+    // hand each entity its components, in their old order
+    for (auto& state : m_snapshot.entities) {
+        auto entity = state.instance;
+        for (int i = 0; i < state.component_count; i++) {
+            auto component = m_snapshot.entity_components[state.first_component + i];
+            entity->m_components.push_back(component);
+            if (entity->add_slot(component)) {
+                gained_type(entity, component->m_type);
+            }
+        }
+    }
+
+    // and the render list, which was already sorted
+    for (auto& it : m_snapshot.visible) {
+        it->m_visible_index = m_visible.size();
+        m_visible.push_back(it);
+    }
+
+    // put the clock back, then let components take up their timers again
+    m_timers.reset(m_snapshot.timer_tick, m_snapshot.timer_time);
+    for (auto& state : m_snapshot.components) {
+        state.instance->awake();
+    }
+}
+
+bool World::has_snapshot() const {
+    return m_snapshot.valid;
+}
+
+void World::discard_snapshot() {
+    for (auto& it : m_snapshot.components) {
+        Component::Types::info(it.saved->m_type).destruct(it.saved);
+    }
+
+    delete[] m_snapshot.data;
+    m_snapshot = Snapshot();
+}
+
+void World::queue(Command::Op op, Entity* entity, Component* component) {
+    Command command;
+    command.op = op;
+    command.entity = entity;
+    command.component = component;
+    m_commands.push_back(command);
+}
+
+void World::flush() {
+    ZEN_PROFILE("World::flush");
+
+    // commands queued while flushing (ex. from destroyed()) are applied
+    // in the same pass, since this walks the list by index
+    for (int i = 0; i < m_commands.size(); i++) {
+        auto command = m_commands[i];
+
+        switch (command.op) {
+            case Command::Op::Spawn: {
+                m_alive.insert(command.entity);
+            } break;
+
+            case Command::Op::Add: {
+                // the entity was destroyed before it got the component. it never
+                // woke, but it still gets to let go of anything it took hold of
+                if (command.entity->m_world != this) {
+                    command.component->destroyed();
+                    command.component->m_entity = nullptr;
+                    m_components_cache[command.component->m_type].insert(command.component);
+                } else {
+                    attach(command.component);
+                }
+            } break;
+
+            case Command::Op::DestroyEntity: {
+                remove(command.entity);
+            } break;
+
+            case Command::Op::DestroyComponent: {
+                if (command.entity->m_world == this) {
+                    remove(command.component);
+                }
+            } break;
+        }
+    }
+
+    m_commands.clear();
+}
+
+void World::attach(Component* component) {
+    // add it to the live components
+    m_components_alive[component->m_type].insert(component);
+
+    // queue it for rendering, it gets sorted into place next render
+    if (Component::Types::info(component->m_type).render_all) {
+        component->m_visible_index = m_visible.size();
+        m_visible.push_back(component);
+    }
+
+    // add it to the m_entity
+    component->m_entity->m_components.push_back(component);
+    if (component->m_entity->add_slot(component)) {
+        gained_type(component->m_entity, component->m_type);
+    }
+
+    component->awake();
+}
+
+void World::release(Component* component) {
+    auto type = component->m_type;
+
+    // mark destroyed
+    component->destroyed();
+
+    // leave a hole in the render list, filled in when it's next sorted
+    if (component->m_visible_index >= 0) {
+        m_visible[component->m_visible_index] = nullptr;
+        component->m_visible_index = -1;
+        m_visible_removed++;
+        if (m_visible_removed > 64 && m_visible_removed > m_visible.size() / 2) {
+            sort_visible();
+        }
+    }
+
+    // remove from list
+    m_components_alive[type].remove(component);
+    m_components_cache[type].insert(component);
+}
+
+void World::remove(Component* component) {
+    release(component);
+
+    // remove from entity
+    if (component->m_entity->remove_slot(component)) {
+        lost_type(component->m_entity, component->m_type);
+    }
+    auto& list = component->m_entity->m_components;
+    for (int i = list.size() - 1; i >= 0; i--) {
+        if (list[i] == component) {
+            list.erase(i);
+            break;
+        }
+    }
+}
+
+void World::remove(Entity* entity) {
+    // release components, then drop the entity's bookkeeping all at once
+    // rather than erasing them from it one at a time
+    for (int i = entity->m_components.size() - 1; i >= 0; i--) {
+        release(entity->m_components[i]);
+    }
+    for (int i = 0; i < m_queries.size(); i++) {
+        unmatch(i, entity);
+    }
+    entity->m_components.clear();
+    entity->m_types = TypeMask();
+    entity->m_slots.clear();
+
+    // remove ourselves from the list
+    m_alive.remove(entity);
+    m_cache.insert(entity);
+
+    // done
+    entity->m_world = nullptr;
+}
+
+int World::find_query(const TypeMask& types) {
+    for (int i = 0; i < m_queries.size(); i++) {
+        if (m_queries[i].types == types) {
+            return i;
+        }
+    }
+
+    // first time anyone asked, so gather up the existing matches
+    int index = m_queries.size();
+    auto query = m_queries.expand();
+    query->types = types;
+
+    for (auto entity = m_alive.first; entity; entity = entity->m_next) {
+        if (entity->m_types.contains(types)) {
+            entity->set_query_index(index, query->entities.size());
+            query->entities.push_back(entity);
+        }
+    }
+
+    return index;
+}
+
+void World::gained_type(Entity* entity, uint8_t type) {
+    for (int i = 0; i < m_queries.size(); i++) {
+        auto& query = m_queries[i];
+        if (query.types.has(type) && entity->m_types.contains(query.types)) {
+            entity->set_query_index(i, query.entities.size());
+            query.entities.push_back(entity);
+        }
+    }
+}
+
+void World::lost_type(Entity* entity, uint8_t type) {
+    for (int i = 0; i < m_queries.size(); i++) {
+        if (m_queries[i].types.has(type)) {
+            unmatch(i, entity);
+        }
+    }
+}
+
+void World::unmatch(int query, Entity* entity) {
+    int index = entity->query_index(query);
+    if (index < 0) {
+        return;
+    }
+
+    // swap the last match into the hole
+    auto& entities = m_queries[query].entities;
+    auto last = entities[entities.size() - 1];
+    entities[index] = last;
+    last->set_query_index(query, index);
+    entities.erase(entities.size() - 1);
+    entity->set_query_index(query, -1);
+}
+
+void World::allocate_entities() {
+    Entity* instances = new Entity[entity_chunk_size];
+
+    Chunk chunk;
+    chunk.instances = instances;
+    chunk.release = [](void* instances) { delete[] (Entity*) instances; };
+    chunk.type = -1;
+    chunk.bytes = sizeof(Entity) * entity_chunk_size;
+    m_chunks.push_back(chunk);
+    m_idle_updates = 0;
+
+    for (int i = 0; i < entity_chunk_size; i++) {
+        m_cache.insert(&instances[i]);
+    }
+}
+
+TimerWheel& World::timers() {
+    return m_timers;
+}
+
+int World::threads() const {
+    return m_scheduler.threads();
+}
+
+void World::set_threads(int count) {
+    m_scheduler.set_threads(count);
+}
+
+const World::CachePolicy& World::cache_policy() const {
+    return m_cache_policy;
+}
+
+void World::set_cache_policy(const CachePolicy& policy) {
+    m_cache_policy = policy;
+    m_idle_updates = 0;
+    m_growth_timer = 0;
+}
+
+World::CacheStats World::component_stats(uint8_t type) const {
+    CacheStats stats;
+    if (type < m_components_alive.size()) {
+        stats.live = m_components_alive[type].count;
+        stats.cached = m_components_cache[type].count;
+    }
+    for (auto& it : m_chunks) {
+        if (it.type == type) {
+            stats.chunks++;
+            stats.bytes += it.bytes;
+        }
+    }
+    return stats;
+}
+
+World::CacheStats World::entity_stats() const {
+    CacheStats stats;
+    stats.live = m_alive.count;
+    stats.cached = m_cache.count;
+    for (auto& it : m_chunks) {
+        if (it.type < 0) {
+            stats.chunks++;
+            stats.bytes += it.bytes;
+        }
+    }
+    return stats;
+}
+
+void World::log_stats() const {
+    auto log = [](const char* name, const CacheStats& stats) {
+        Log::print("  %-20s %6i live %6i cached %4i chunks %8i bytes",
+                   name, stats.live, stats.cached, stats.chunks, (int) stats.bytes);
+    };
+
+    Log::print("World caches:");
+    log("Entity", entity_stats());
+    for (int i = 0; i < m_components_alive.size(); i++) {
+        log(Component::type_name(i), component_stats(i));
+    }
+}
+
+void World::trim() {
+    ZEN_PROFILE("World::trim");
+
+    for (int i = 0; i < m_components_cache.size(); i++) {
+        trim_chunks(m_components_cache[i], i);
+    }
+    trim_chunks(m_cache, -1);
+}
+
+template<class T> int World::trim_chunks(Pool<T>& cache, int type) {
+    int chunk_size = (type < 0 ? entity_chunk_size : component_chunk_size);
+    if (cache.count - chunk_size < m_cache_policy.keep) {
+        return 0;
+    }
+
+    // find the type's chunks, and how many of each one's instances are cached
+    struct Candidate {
+        int chunk;
+        int cached;
+        bool pinned;
+    };
+
+    Vector<Candidate> candidates;
+    for (int i = 0; i < m_chunks.size(); i++) {
+        if (m_chunks[i].type == type) {
+            Candidate candidate;
+            candidate.chunk = i;
+            candidate.cached = 0;
+            candidate.pinned = false;
+            candidates.push_back(candidate);
+        }
+    }
+
+    auto find = [&](const void* instance) -> Candidate* {
+        for (auto& it : candidates) {
+            auto& chunk = m_chunks[it.chunk];
+            auto begin = (const unsigned char*) chunk.instances;
+            if (instance >= begin && instance < begin + chunk.bytes) {
+                return &it;
+            }
+        }
+        return nullptr;
+    };
+
+    for (auto it = cache.first; it; it = it->m_next) {
+        find(it)->cached++;
+    }
+
+    // the snapshot brings its instances back on restore, so they have to stay
+    if (type < 0) {
+        for (auto& it : m_snapshot.entities) {
+            find(it.instance)->pinned = true;
+        }
+    } else {
+        for (auto& it : m_snapshot.components) {
+            if (it.instance->m_type == type) {
+                find(it.instance)->pinned = true;
             }
-            component = next;
         }
     }
+
+    // free the newest chunks first, since the oldest are the most likely to
+    // still have instances in use. freed chunks get their cached count zeroed
+    int remaining = cache.count;
+    int freed = 0;
+    for (int i = candidates.size() - 1; i >= 0; i--) {
+        auto& it = candidates[i];
+        if (it.cached == chunk_size && !it.pinned && remaining - chunk_size >= m_cache_policy.keep) {
+            remaining -= chunk_size;
+            it.cached = 0;
+            freed++;
+        } else {
+            it.cached = -1;
+        }
+    }
+
+    if (freed <= 0) {
+        return 0;
+    }
+
+    // pull the freed chunks' instances out of the cache
+    auto it = cache.first;
+    while (it) {
+        auto next = it->m_next;
+        if (find(it)->cached == 0) {
+            cache.remove(it);
+        }
+        it = next;
+    }
+
+    // then release them, from the back so the remaining indices stay put
+    for (int i = candidates.size() - 1; i >= 0; i--) {
+        if (candidates[i].cached == 0) {
+            auto& chunk = m_chunks[candidates[i].chunk];
+            chunk.release(chunk.instances);
+            m_chunks.erase(candidates[i].chunk);
+        }
+    }
+
+    return freed;
 }
 
-void World::render(Batch& batch) {
-    // Notes:
-    // In general this isn't a great way to render objects.
-    // Every frame it has to rebuild the list and sort it.
-    // A more ideal way would be to cache the visible list
-    // and insert / remove objects as they update or change
-    // their depth
+void World::check_growth() {
+    for (auto entity = m_alive.first; entity; entity = entity->m_next) {
+        int count = entity->m_components.size();
+        if (count > entity->m_checked_components) {
+            entity->m_growth_strikes++;
+        } else if (count < entity->m_checked_components) {
+            entity->m_growth_strikes = 0;
+        }
+        entity->m_checked_components = count;
 
-    // assemble list
+        if (entity->m_growth_strikes < growth_check_strikes) {
+            continue;
+        }
+        entity->m_growth_strikes = 0;
+
+        // name the type it has the most of, that's usually the culprit
+        int counts[max_component_types] = {};
+        int most = entity->m_components[0]->m_type;
+        for (auto& it : entity->m_components) {
+            if (++counts[it->m_type] > counts[most]) {
+                most = it->m_type;
+            }
+        }
+
+        Log::warn("Entity at %i, %i keeps gaining components: it has %i, %i of them %s",
+                  entity->position.x, entity->position.y, count, counts[most], Component::type_name(most));
+    }
+}
+
+void World::grow_types() {
+    // the per-type lists only cover types that exist so far
+    while (m_components_alive.size() < Component::Types::count()) {
+        m_components_cache.expand();
+        m_components_alive.expand();
+    }
+}
+
+void World::build_stages() {
+    // group consecutive types into stages as long as they don't conflict,
+    // so conflicting types still update in the same order as before
+    m_stages.clear();
+    grow_types();
+
+    Access stage_access[max_component_types];
     for (int i = 0; i < Component::Types::count(); i++) {
-        auto component = m_components_alive[i].first;
-        while (component) {
-            if (component->visible && component->m_entity->visible) {
-                m_visible.push_back(component);
+        // types without an update() override never need visiting
+        if (!Component::Types::info(i).update_all) {
+            continue;
+        }
+
+        auto access = Component::Types::access(i);
+
+        bool joins = m_stages.size() > 0 && m_stages.back().parallel && !access.exclusive;
+        if (joins) {
+            auto& stage = m_stages.back();
+            for (int j = stage.first; j < stage.first + stage.count; j++) {
+                if (access.conflicts(stage_access[j])) {
+                    joins = false;
+                    break;
+                }
             }
-            component = component->m_next;
         }
+
+        if (joins) {
+            m_stages.back().count = i - m_stages.back().first + 1;
+        } else {
+            Stage stage;
+            stage.first = i;
+            stage.count = 1;
+            stage.parallel = !access.exclusive;
+            m_stages.push_back(stage);
+        }
+
+        stage_access[i] = access;
+    }
+
+    m_staged_types = Component::Types::count();
+}
+
+void World::update() {
+    ZEN_PROFILE("World::update");
+
+    if (m_staged_types != Component::Types::count()) {
+        build_stages();
     }
 
-    // sort by depth
-    std::sort(m_visible.begin(), m_visible.end(),
-              [](const Component* a, const Component* b) {
-                    return a->depth > b->depth;
-              });
+    // let services catch up on anything that changed between updates
+    for (auto& it : m_services) {
+        if (it.before_update) {
+            it.before_update(it.instance);
+        }
+    }
 
-    // render them
-    for (auto& it : m_visible) {
-        it->render(batch);
+    // remember where everything started, for interpolated rendering
+    for (auto entity = m_alive.first; entity; entity = entity->m_next) {
+        entity->m_last_position = entity->position;
     }
 
-    // clear list for the next time around
-    m_visible.clear();
+    // structural changes made by components while updating are queued,
+    // and applied after each stage so nothing changes under the loops
+    m_deferring = true;
+
+    for (auto& stage : m_stages) {
+        // gather the stage's components, remembering where each type starts
+        m_jobs.clear();
+        m_job_runs.clear();
+        for (int i = stage.first; i < stage.first + stage.count; i++) {
+            if (!Component::Types::info(i).update_all) {
+                continue;
+            }
+
+            JobRun run;
+            run.type = i;
+            run.first = m_jobs.size();
+            m_job_runs.push_back(run);
+
+            auto component = m_components_alive[i].first;
+            while (component) {
+                m_jobs.push_back(component);
+                component = component->m_next;
+            }
+        }
+
+        // calls each type's update_all over its part of [begin, end)
+        auto update_range = [this](int begin, int end) {
+            for (int i = 0; i < m_job_runs.size(); i++) {
+                int from = std::max(begin, m_job_runs[i].first);
+                int to = std::min(end, i + 1 < m_job_runs.size() ? m_job_runs[i + 1].first : m_jobs.size());
+                if (from < to) {
+                    ZEN_PROFILE(Component::Types::name(m_job_runs[i].type));
+                    Component::Types::info(m_job_runs[i].type).update_all(&m_jobs[from], to - from);
+                }
+            }
+        };
+
+        // exclusive types update one at a time, in order. nothing in a
+        // parallel stage conflicts, so its instances can update in any
+        // order and still give the same result
+        if (!stage.parallel || m_jobs.size() < parallel_threshold) {
+            update_range(0, m_jobs.size());
+        } else {
+            m_scheduler.run(m_jobs.size(), parallel_batch_size, update_range);
+        }
+
+        // sync point
+        flush();
+    }
+
+    // fire any timers that came due, then sync up after them too
+    m_timers.advance(Time::delta);
+    flush();
+
+    m_deferring = false;
+
+    // hand back memory the policy says we've been holding on to for too long
+    if (m_cache_policy.idle_updates > 0 && ++m_idle_updates == m_cache_policy.idle_updates) {
+        trim();
+    } else if (m_cache_policy.high_water > 0) {
+        for (int i = 0; i < m_components_cache.size(); i++) {
+            if (m_components_cache[i].count > m_cache_policy.high_water) {
+                trim_chunks(m_components_cache[i], i);
+            }
+        }
+        if (m_cache.count > m_cache_policy.high_water) {
+            trim_chunks(m_cache, -1);
+        }
+    }
+
+    if (m_cache_policy.growth_check_interval > 0 && ++m_growth_timer >= m_cache_policy.growth_check_interval) {
+        m_growth_timer = 0;
+        check_growth();
+    }
+}
+
+void World::sort_visible() {
+    // compact out destroyed components, keeping count of how many of them
+    // were in the part that was sorted last time
+    int count = 0;
+    int sorted = 0;
+    for (int i = 0; i < m_visible.size(); i++) {
+        if (m_visible[i]) {
+            sorted += (i < m_visible_sorted);
+            m_visible[count++] = m_visible[i];
+        }
+    }
+
+    bool compacted = (count < m_visible.size());
+    if (compacted) {
+        m_visible.erase(count, m_visible.size() - count);
+    }
+
+    // depth is a plain field, so a change only shows up as the sorted part
+    // being out of order, in which case it all gets sorted again. otherwise
+    // only what was added since needs sorting, and then merging in
+    auto deeper = [](const Component* a, const Component* b) { return a->depth > b->depth; };
+    auto begin = m_visible.begin();
+    auto end = m_visible.end();
+    if (!std::is_sorted(begin, begin + sorted, deeper)) {
+        std::stable_sort(begin, end, deeper);
+    } else if (sorted < count) {
+        std::stable_sort(begin + sorted, end, deeper);
+        std::inplace_merge(begin, begin + sorted, end, deeper);
+    } else if (!compacted) {
+        return;
+    }
+
+    m_visible_sorted = count;
+    m_visible_removed = 0;
+
+    for (int i = 0; i < m_visible.size(); i++) {
+        m_visible[i]->m_visible_index = i;
+    }
+}
+
+void World::render(Batch& batch, float interpolation) {
+    ZEN_PROFILE("World::render");
+    m_interpolation = interpolation;
+
+    // every live component stays in the depth sorted render list, so only
+    // new components and depth changes cost anything to sort. visibility
+    // is checked here rather than tracked, since it toggles constantly
+    {
+        ZEN_PROFILE("World::render sort");
+        sort_visible();
+    }
+
+    // draw runs of the same type through the type's render_all
+    ZEN_PROFILE("World::render draw");
+    for (int i = 0; i < m_visible.size();) {
+        auto type = m_visible[i]->m_type;
+
+        int end = i + 1;
+        while (end < m_visible.size() && m_visible[end]->m_type == type) {
+            end++;
+        }
+
+        Component::Types::info(type).render_all(&m_visible[i], end - i, batch);
+        i = end;
+    }
+}
+
+float World::interpolation() const {
+    return m_interpolation;
 }
@@ -1,15 +1,56 @@
 #pragma once
 
 #include <blah.h>
+#include <type_traits>
+#include <utility>
+#include "scheduler.h"
+#include "timer_wheel.h"
 
 namespace Zen {
 
     class World;
     class Entity;
 
+    // a set of component types, one bit per type id
+    struct TypeMask {
+        static constexpr int capacity = 64;
+
+        uint64_t bits[capacity / 64] = {};
+
+        bool has(uint8_t type) const;
+        void set(uint8_t type);
+        void reset(uint8_t type);
+
+        // number of types in the set with a lower id than the given type
+        int rank(uint8_t type) const;
+
+        bool intersects(const TypeMask& other) const;
+        bool contains(const TypeMask& other) const;
+
+        bool operator==(const TypeMask& other) const;
+    };
+
+    // The component types a component type's update() reads and writes.
+    // A type that declares its access promises that update() only touches
+    // its own instance, plus the declared types, and makes no structural
+    // changes to the World. That lets the World update it at the same time
+    // as other instances and non-conflicting types. Types that don't
+    // declare anything are exclusive and always update alone, in order.
+    struct Access {
+        bool exclusive = true;
+        TypeMask reads;
+        TypeMask writes;
+
+        template<class T> Access& read();
+        template<class T> Access& write();
+
+        bool conflicts(const Access& other) const;
+    };
+
     class Component {
         friend class World;
         friend class Entity;
+        friend struct Access;
 
     public:
         bool active = true;
@@ -35,6 +76,18 @@ namespace Zen {
 
         void destroy();
 
+        // true once destroy() has been called, even though the World
+        // may not remove the component until its next sync point
+        bool is_destroyed() const;
+
+        // override to declare the type's access, see Access
+        static void declare(Access& access);
+
+        // gives a component type the next id, see Types::add
+        template<class T> static uint8_t register_type(const char* name);
+        template<class T> static uint8_t type_id();
+        static const char* type_name(uint8_t type);
+
         virtual void awake();
         virtual void update();
         virtual void render(Blah::Batch& batch);
@@ -42,21 +95,108 @@ namespace Zen {
 
     private:
         uint8_t m_type = 0;
+        bool m_destroyed = false;
+        int m_visible_index = -1;
         Entity* m_entity = nullptr;
         Component *m_prev = nullptr;
         Component *m_next = nullptr;
 
         class Types {
+        public:
+            // type level functions, generated when the type gets its id.
+            // update_all and render_all call the type's own overrides
+            // directly, and are null if the type doesn't override them
+            struct Info {
+                const char* name;
+                int size;
+                int align;
+                void (*declare)(Access& access);
+                void (*copy)(void* memory, const Component* from);
+                void (*assign)(Component* to, const Component* from);
+                void (*destruct)(Component* component);
+                void (*update_all)(Component* const* components, int count);
+                void (*render_all)(Component* const* components, int count, Blah::Batch& batch);
+            };
+
         private:
             static inline uint8_t counter = 0;
+            static inline Info infos[TypeMask::capacity];
 
         public:
             static uint8_t count() { return counter; }
 
+            // registers a type under the next id. types registered up front
+            // in a fixed order get the same ids on every run, no matter
+            // which one the game happens to use first. types that are
+            // never registered get an id (and no name) on first use
+            template<class T> static uint8_t add(const char* name) {
+                BLAH_ASSERT(id<T>() == counter - 1, "Component type was used before it was registered");
+                infos[id<T>()].name = name;
+                return id<T>();
+            }
+
             template<class T> static uint8_t  id() {
-                static const uint8_t value = Types::counter++;
+                static const uint8_t value = Types::make<T>();
                 return value;
             }
+
+            static const Info& info(uint8_t type) {
+                return infos[type];
+            }
+
+            static const char* name(uint8_t type) {
+                return (infos[type].name ? infos[type].name : "Component");
+            }
+
+            static Access access(uint8_t type) {
+                Access access;
+                infos[type].declare(access);
+                return access;
+            }
+
+        private:
+            template<class T> static uint8_t make() {
+                BLAH_ASSERT(counter < TypeMask::capacity, "Too many component types");
+
+                // a type that doesn't override a function inherits Component's
+                constexpr bool updates = !std::is_same_v<decltype(&T::update), void (Component::*)()>;
+                constexpr bool renders = !std::is_same_v<decltype(&T::render), void (Component::*)(Blah::Batch&)>;
+
+                Info& info = infos[counter];
+                info.name = nullptr;
+                info.size = sizeof(T);
+                info.align = alignof(T);
+                info.declare = &T::declare;
+                info.copy = [](void* memory, const Component* from) { new (memory) T(*(const T*) from); };
+                info.assign = [](Component* to, const Component* from) { *(T*) to = *(const T*) from; };
+                info.destruct = [](Component* component) { ((T*) component)->~T(); };
+                info.update_all = nullptr;
+                info.render_all = nullptr;
+
+                if constexpr (updates) {
+                    info.update_all = [](Component* const* components, int count) {
+                        for (int i = 0; i < count; i++) {
+                            auto component = (T*) components[i];
+                            if (component->active && component->m_entity->active && !component->m_destroyed) {
+                                component->T::update();
+                            }
+                        }
+                    };
+                }
+
+                if constexpr (renders) {
+                    info.render_all = [](Component* const* components, int count, Blah::Batch& batch) {
+                        for (int i = 0; i < count; i++) {
+                            auto component = (T*) components[i];
+                            if (component->visible && component->m_entity->visible) {
+                                component->T::render(batch);
+                            }
+                        }
+                    };
+                }
+
+                return counter++;
+            }
         };
 
     };
@@ -69,6 +209,10 @@ namespace Zen {
         bool visible = true;
         Blah::Point position;
 
+        // the position to draw at, blended between where the entity was when
+        // the last World::update started and where it is now, see World::render
+        Blah::Vec2 render_position() const;
+
         World *world();
         const World* world() const;
 
@@ -83,22 +227,47 @@ namespace Zen {
         template<class T> T *get();
         template<class T> const T *get() const;
 
+        template<class T> bool has() const;
+
         Blah::Vector<Component*>& components();
         const Blah::Vector<Component*>& components() const;
 
         void destroy();
 
     private:
+        bool add_slot(Component* component);
+        bool remove_slot(Component* component);
+
+        int query_index(int query) const;
+        void set_query_index(int query, int index);
+
         Blah::Vector<Component*> m_components;
+        TypeMask m_types;
+        Blah::Vector<Component*> m_slots;
+        Blah::Vector<int> m_query_indices;
+        bool m_destroyed = false;
+        Blah::Point m_last_position;
+        int m_checked_components = 0;
+        int m_growth_strikes = 0;
         World *m_world = nullptr;
         Entity* m_prev = nullptr;
         Entity* m_next = nullptr;
 
     };
 
+    // whether a World service has a before_update() to call, see World::service
+    template<class T, class = void> struct has_before_update : std::false_type {};
+    template<class T> struct has_before_update<T, std::void_t<decltype(std::declval<T&>().before_update())>> : std::true_type {};
+
     class World {
     public:
-        static constexpr int max_component_types = 256;
+        static constexpr int max_component_types = TypeMask::capacity;
+        static constexpr int component_chunk_size = 64;
+        static constexpr int entity_chunk_size = 64;
+
+        // parallel stages only fan out once they have this many components
+        static constexpr int parallel_threshold = 256;
+        static constexpr int parallel_batch_size = 64;
 
         World() = default;
         World(const World&) = delete;
@@ -125,29 +294,312 @@ namespace Zen {
         template<class T> T* last();
         template<class T> const T* last() const;
 
+        // calls fn(T*...) for every entity that has all of the given component
+        // types. matches are cached and kept up to date as components come
+        // and go, so this only costs as much as the number of matches.
+        // structural changes made by fn are applied once iteration finishes
+        template<class... T, class F> void each(F&& fn);
+
         void destroy(Component *component);
         void clear();
 
+        // saves the state of every entity and component. restore() clears
+        // the world and brings back those same instances with that state,
+        // so pointers between them stay valid without being remapped
+        void snapshot();
+        void restore();
+        bool has_snapshot() const;
+        void discard_snapshot();
+
+        // entities that moved further than this in one update snap to their
+        // new position when rendering, rather than being blended there
+        static constexpr int max_interpolation_distance = 16;
+
+        // number of threads used to update non-conflicting component types
+        int threads() const;
+        void set_threads(int count);
+
+        // when cached instances are handed back to the allocator. a chunk can
+        // only be freed once every instance in it is cached, and none of them
+        // are held on to by the snapshot
+        struct CachePolicy {
+            // trim a type once it has more than this many cached instances, 0 for never
+            int high_water = 0;
+
+            // trim every type after this many updates without allocating, 0 for never
+            int idle_updates = 0;
+
+            // cached instances each type keeps when it's trimmed
+            int keep = component_chunk_size;
+
+            // updates between checks for entities that keep gaining components, 0 for never
+            int growth_check_interval = 0;
+        };
+
+        // an entity is reported once its component count has grown this many checks in a row
+        static constexpr int growth_check_strikes = 8;
+
+        struct CacheStats {
+            int live = 0;
+            int cached = 0;
+            int chunks = 0;
+            size_t bytes = 0;
+        };
+
+        const CachePolicy& cache_policy() const;
+        void set_cache_policy(const CachePolicy& policy);
+
+        CacheStats component_stats(uint8_t type) const;
+        CacheStats entity_stats() const;
+        void log_stats() const;
+
+        // frees every chunk the policy's keep count allows, for every type
+        void trim();
+
+        // scheduled callbacks, see Timer. due entries fire at the end of each
+        // update and can make structural changes like any component
+        TimerWheel& timers();
+
+        // a per-World instance of T, created on first use and destroyed along
+        // with the World, for systems to keep their own state in. services
+        // with a before_update() function get it called as each update starts
+        template<class T> T& service();
+
         void update();
-        void render(Blah::Batch& batch);
+
+        // interpolation blends entity render positions from where they were
+        // at the start of the last update (0) to where they are now (1)
+        void render(Blah::Batch& batch, float interpolation = 1.0f);
+        float interpolation() const;
 
     private:
         template<class T> struct Pool {
             T* first = nullptr;
             T* last = nullptr;
+            int count = 0;
 
             void insert(T* instance);
             void remove(T* instance);
         };
 
+        // a contiguous slab of instances, all of which start out in a cache.
+        // type is the component type id, or -1 for entities
+        struct Chunk {
+            void* instances;
+            void (*release)(void* instances);
+            int type;
+            size_t bytes;
+        };
+
+        // a structural change made during update(), applied at the next sync point
+        struct Command {
+            enum class Op {
+                Spawn,
+                Add,
+                DestroyEntity,
+                DestroyComponent
+            };
+
+            Op op;
+            Entity* entity;
+            Component* component;
+        };
+
+        // the entities matching a set of component types, see each()
+        struct Query {
+            TypeMask types;
+            Blah::Vector<Entity*> entities;
+        };
+
+        // saved copies of every entity and component, see snapshot()
+        struct Snapshot {
+            struct EntityState {
+                Entity* instance;
+                Blah::Point position;
+                bool active;
+                bool visible;
+                int first_component;
+                int component_count;
+            };
+
+            struct ComponentState {
+                Component* instance;
+                Component* saved;
+            };
+
+            bool valid = false;
+            unsigned char* data = nullptr;
+            uint64_t timer_tick = 0;
+            double timer_time = 0;
+            Blah::Vector<EntityState> entities;
+            Blah::Vector<Component*> entity_components;
+            Blah::Vector<ComponentState> components;
+            Blah::Vector<Component*> visible;
+        };
+
+        // a run of consecutive component types that can update together
+        struct Stage {
+            int first;
+            int count;
+            bool parallel;
+        };
+
+        // an instance made by service<T>()
+        struct Service {
+            void* instance;
+            void (*destroy)(void* instance);
+            void (*before_update)(void* instance);
+        };
+
+        static inline int s_service_count = 0;
+        template<class T> static int service_id();
+
+        // where a type's components start in the gathered update jobs
+        struct JobRun {
+            int type;
+            int first;
+        };
+
+        template<class T> void allocate_components(uint8_t type);
+        void allocate_entities();
+        void grow_types();
+        void sort_visible();
+        void build_stages();
+
+        template<class T> int trim_chunks(Pool<T>& cache, int type);
+        void check_growth();
+
+        void queue(Command::Op op, Entity* entity, Component* component);
+        void flush();
+        void attach(Component* component);
+        void release(Component* component);
+        void remove(Component* component);
+        void remove(Entity* entity);
+
+        int find_query(const TypeMask& types);
+        void gained_type(Entity* entity, uint8_t type);
+        void lost_type(Entity* entity, uint8_t type);
+        void unmatch(int query, Entity* entity);
+
+        Blah::Vector<Chunk> m_chunks;
         Pool<Entity> m_cache;
         Pool<Entity> m_alive;
-        Pool<Component> m_components_cache[max_component_types];
-        Pool<Component> m_components_alive[max_component_types];
+        Blah::Vector<Pool<Component>> m_components_cache;
+        Blah::Vector<Pool<Component>> m_components_alive;
         Blah::Vector<Component*> m_visible;
+        int m_visible_sorted = 0;
+        int m_visible_removed = 0;
+        float m_interpolation = 1.0f;
+        bool m_deferring = false;
+        Blah::Vector<Command> m_commands;
+        Blah::Vector<Query> m_queries;
+        Snapshot m_snapshot;
+        Blah::Vector<Stage> m_stages;
+        int m_staged_types = 0;
+        Blah::Vector<Component*> m_jobs;
+        Blah::Vector<JobRun> m_job_runs;
+        Scheduler m_scheduler;
+        TimerWheel m_timers;
+        Blah::Vector<Service> m_services;
+        CachePolicy m_cache_policy;
+        int m_idle_updates = 0;
+        int m_growth_timer = 0;
 
     };
 
+    inline bool TypeMask::has(uint8_t type) const {
+        return (bits[type >> 6] >> (type & 63)) & 1;
+    }
+
+    inline void TypeMask::set(uint8_t type) {
+        bits[type >> 6] |= (uint64_t) 1 << (type & 63);
+    }
+
+    inline void TypeMask::reset(uint8_t type) {
+        bits[type >> 6] &= ~((uint64_t) 1 << (type & 63));
+    }
+
+    inline int TypeMask::rank(uint8_t type) const {
+        // without a popcnt instruction to use, the builtin turns into a call
+        // into the runtime library, which costs more than counting inline
+        auto popcount = [](uint64_t v) {
+#if defined(__POPCNT__)
+            return __builtin_popcountll(v);
+#else
+            v = v - ((v >> 1) & 0x5555555555555555ull);
+            v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return (int) ((v * 0x0101010101010101ull) >> 56);
+#endif
+        };
+
+        int word = type >> 6;
+        int count = popcount(bits[word] & (((uint64_t) 1 << (type & 63)) - 1));
+        for (int i = 0; i < word; i++) {
+            count += popcount(bits[i]);
+        }
+        return count;
+    }
+
+    inline bool TypeMask::intersects(const TypeMask& other) const {
+        for (int i = 0; i < capacity / 64; i++) {
+            if (bits[i] & other.bits[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool TypeMask::contains(const TypeMask& other) const {
+        for (int i = 0; i < capacity / 64; i++) {
+            if ((bits[i] & other.bits[i]) != other.bits[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool TypeMask::operator==(const TypeMask& other) const {
+        for (int i = 0; i < capacity / 64; i++) {
+            if (bits[i] != other.bits[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<class T> Access& Access::read() {
+        exclusive = false;
+        reads.set(Component::Types::id<T>());
+        return *this;
+    }
+
+    template<class T> Access& Access::write() {
+        exclusive = false;
+        writes.set(Component::Types::id<T>());
+        return *this;
+    }
+
+    inline bool Access::conflicts(const Access& other) const {
+        return exclusive
+            || other.exclusive
+            || writes.intersects(other.reads)
+            || writes.intersects(other.writes)
+            || other.writes.intersects(reads);
+    }
+
+    template<class T> uint8_t Component::register_type(const char* name) {
+        return Types::add<T>(name);
+    }
+
+    template<class T> uint8_t Component::type_id() {
+        return Types::id<T>();
+    }
+
+    inline const char* Component::type_name(uint8_t type) {
+        return Types::name(type);
+    }
+
     template<class T> T* Component::get() {
         BLAH_ASSERT(m_entity, "Component must be assigned to an Entity");
         return m_entity->get<T>();
@@ -165,52 +617,57 @@ namespace Zen {
 
     template<class T> T* Entity::get() {
         BLAH_ASSERT(m_world, "Entity must be assigned to a World");
-        for (auto& it : m_components) {
-            if (it->m_type == Component::Types::id<T>()) {
-                return (T*) it;
-            }
+        uint8_t type = Component::Types::id<T>();
+        if (m_types.has(type)) {
+            return (T*) m_slots[m_types.rank(type)];
         }
         return nullptr;
     }
 
     template<class T> const T* Entity::get() const {
         BLAH_ASSERT(m_world, "Entity must be assigned to a World");
-        for (auto& it : m_components) {
-            if (it->m_type == Component::Types::id<T>()) {
-                return (T*) it;
-            }
+        uint8_t type = Component::Types::id<T>();
+        if (m_types.has(type)) {
+            return (const T*) m_slots[m_types.rank(type)];
         }
         return nullptr;
     }
 
+    template<class T> bool Entity::has() const {
+        return m_types.has(Component::Types::id<T>());
+    }
+
     template<class T> T* World::add(Entity *entity, T&& component) {
         BLAH_ASSERT(entity, "Entity cannot be null");
         BLAH_ASSERT(entity->m_world == this, "Entity must be part of this m_world");
 
         // get the component m_type
         uint8_t type = Component::Types::id<T>();
+        if (type >= m_components_cache.size()) {
+            grow_types();
+        }
         auto& cache = m_components_cache[type];
-        auto& alive = m_components_alive[type];
 
-        // instantiate a new instance
-        T* instance;
-        if (cache.first) {
-            instance = (T*) cache.first;
-            cache.remove(instance);
-        } else {
-            instance = new T();
+        // grab an instance from the cache, growing it by a chunk if it's empty
+        if (!cache.first) {
+            allocate_components<T>(type);
         }
 
+        T* instance = (T*) cache.first;
+        cache.remove(instance);
+
         // construct the new instance
         *instance = component;
         instance->m_type = type;
         instance->m_entity = entity;
+        instance->m_destroyed = false;
 
-        // add it to the live components
-        alive.insert(instance);
-
-        // add it to the m_entity
-        entity->m_components.push_back(instance);
+        // hook it up to the world and entity, or wait for the next sync point
+        if (m_deferring) {
+            queue(Command::Op::Add, entity, instance);
+        } else {
+            attach(instance);
+        }
 
         // and we're done
         return instance;
@@ -218,22 +675,88 @@ namespace Zen {
 
     template<class T> T* World::first() {
         uint8_t type = Component::Types::id<T>();
-        return (T*) m_components_alive[type].first;
+        return (type < m_components_alive.size() ? (T*) m_components_alive[type].first : nullptr);
     }
 
     template<class T> const T* World::first() const {
         uint8_t type = Component::Types::id<T>();
-        return (T*) m_components_alive[type].first;
+        return (type < m_components_alive.size() ? (T*) m_components_alive[type].first : nullptr);
     }
 
     template<class T> T* World::last() {
         uint8_t type = Component::Types::id<T>();
-        return (T*) m_components_alive[type].last;
+        return (type < m_components_alive.size() ? (T*) m_components_alive[type].last : nullptr);
     }
 
     template<class T> const T* World::last() const {
         uint8_t type = Component::Types::id<T>();
-        return (T*) m_components_alive[type].last;
+        return (type < m_components_alive.size() ? (T*) m_components_alive[type].last : nullptr);
+    }
+
+    template<class... T, class F> void World::each(F&& fn) {
+        TypeMask types;
+        (types.set(Component::Types::id<T>()), ...);
+
+        // fn may make a query of its own, which can grow m_queries, so this
+        // one is looked up by index each time rather than held on to
+        int query = find_query(types);
+
+        // hold off structural changes so the match list can't change under us
+        bool deferring = m_deferring;
+        m_deferring = true;
+
+        for (int i = 0; i < m_queries[query].entities.size(); i++) {
+            auto entity = m_queries[query].entities[i];
+            if (!entity->m_destroyed) {
+                fn(entity->get<T>()...);
+            }
+        }
+
+        if (!deferring) {
+            flush();
+            m_deferring = false;
+        }
+    }
+
+    template<class T> int World::service_id() {
+        static const int id = s_service_count++;
+        return id;
+    }
+
+    template<class T> T& World::service() {
+        int id = service_id<T>();
+        while (m_services.size() <= id) {
+            m_services.push_back(Service { nullptr, nullptr, nullptr });
+        }
+
+        auto& it = m_services[id];
+        if (!it.instance) {
+            it.instance = new T();
+            it.destroy = [](void* instance) { delete (T*) instance; };
+            if constexpr (has_before_update<T>::value) {
+                it.before_update = [](void* instance) { ((T*) instance)->before_update(); };
+            }
+        }
+
+        return *(T*) it.instance;
+    }
+
+    template<class T> void World::allocate_components(uint8_t type) {
+        // construct the whole chunk up front so every instance is contiguous
+        // and the cache can hand them out without touching the allocator
+        T* instances = new T[component_chunk_size];
+
+        Chunk chunk;
+        chunk.instances = instances;
+        chunk.release = [](void* instances) { delete[] (T*) instances; };
+        chunk.type = type;
+        chunk.bytes = sizeof(T) * component_chunk_size;
+        m_chunks.push_back(chunk);
+        m_idle_updates = 0;
+
+        for (int i = 0; i < component_chunk_size; i++) {
+            m_components_cache[type].insert(&instances[i]);
+        }
     }
 
     template<class T> void World::Pool<T>::insert(T* instance) {
@@ -247,6 +770,7 @@ namespace Zen {
             instance->m_next = nullptr;
             instance->m_prev = nullptr;
         }
+        count++;
     }
 
     template<class T> void World::Pool<T>::remove(T* instance) {
@@ -258,6 +782,7 @@ namespace Zen {
 
         instance->m_next = nullptr;
         instance->m_prev = nullptr;
+        count--;
     }
 
 }